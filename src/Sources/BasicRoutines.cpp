@@ -19,10 +19,17 @@
 #include <string>
 #include <cmath>
 #include <iostream>
+#include <thread>
+#include <algorithm>
+#include <climits>
 
 #include "BasicRoutines.h"
 #include "MaterialProperties.h"
 
+#include <TopologyDescriptor.h>
+#include <LoadBalancer.h>
+#include <HaloExchanger.h>
+
 
 
 /**
@@ -44,6 +51,22 @@ void TParameters::PrintParameters() const
     cout << "AirFlow:" << airFlowRate << endl;
     cout << "InputFile:" << materialFileName.c_str() << endl;
     cout << "Imbalance threshold: " << std::fixed << threshold << endl;
+    cout << "Kernel:" << KernelName(kernel) << endl;
+    cout << "TemporalSteps:" << temporalSteps << endl;
+    cout << "Exchange:" << exchange << endl;
+    cout << "Progress:" << progress << endl;
+    cout << "Threads:" << threads << endl;
+    cout << "RowChunk:" << rowChunk << endl;
+    cout << "Strategy:" << strategy << endl;
+    cout << "CostModel:" << costModel << endl;
+    cout << "Estimator:" << estimator << endl;
+    cout << "Hysteresis:" << hysteresis << endl;
+    cout << "CostGate:" << costGate << endl;
+    cout << "MigrationBudget:" << migrationBudget << endl;
+    cout << "AsyncLag:" << asyncLag << endl;
+    cout << "NativeMigration:" << nativeMigration << endl;
+    cout << "NodeAware:" << nodeAware << endl;
+    cout << "NodePlacement:" << nodePlacement << endl;
 
   }
   else
@@ -58,6 +81,22 @@ void TParameters::PrintParameters() const
     printf("Output file name    : %s \n",     outputFileName.c_str());
     printf("Mode                : %d \n",     mode);
     printf("Object size         : %d \n",     objDim);
+    printf("Compute kernel      : %s (%s)\n",  KernelName(kernel), SimdExtension());
+    printf("Steps per exchange  : %u \n",     temporalSteps);
+    printf("Halo exchange       : %d \n",     exchange);
+    printf("Exchange progress   : %d \n",     progress);
+    printf("Threads per rank    : %d \n",     threads);
+    printf("Row chunk stealing  : %d \n",     rowChunk);
+    printf("Balancing strategy  : %d \n",     strategy);
+    printf("Object cost model   : %s \n",     costModel ? "sampled" : "uniform");
+    printf("Time estimator      : %d \n",     estimator);
+    printf("Hysteresis periods  : %d \n",     hysteresis);
+    printf("Cost-benefit gate   : %s \n",     costGate ? "on" : "off");
+    printf("Migration budget    : %d \n",     migrationBudget);
+    printf("Async migration lag : %d \n",     asyncLag);
+    printf("Migration engine    : %s \n",     nativeMigration ? "rectangles" : "zoltan");
+    printf("Node-aware balancing: %s \n",     nodeAware ? "on" : "off");
+    printf("Node placement      : %s \n",     nodePlacement ? "blocks" : "rows");
     printf("...................................................\n\n");
   }
 } // end of PrintParameters
@@ -81,9 +120,12 @@ void ParseCommandline(int argc, char *argv[], TParameters &parameters)
   bool T_flag = false;
   bool M_flag = false;
 
+  // signed, negative steps must not wrap around
+  long temporalSteps = parameters.temporalSteps;
+
   string temp, xs,ys;
 
-  while ((c = getopt (argc, argv, "n:w:a:dvi:o:bm:ps:t:XT:M:")) != -1)
+  while ((c = getopt (argc, argv, "n:w:a:dvi:o:bm:ps:t:XT:M:K:D:e:g:j:r:q:L:CE:H:GB:A:RNP")) != -1)
   {
     switch (c)
     {
@@ -160,13 +202,92 @@ void ParseCommandline(int argc, char *argv[], TParameters &parameters)
         M_flag = true;
         break;
 
+      case 'K':
+        parameters.kernel = atoi(optarg);
+        break;
+
+      case 'D':
+        temporalSteps = atol(optarg);
+        break;
+
+      case 'e':
+        // auto - chosen by benchmark at startup
+        parameters.exchange = (std::string(optarg) == "auto") ? DLB::EXCHANGE_AUTO : atoi(optarg);
+        break;
+
+      case 'g':
+        parameters.progress = atoi(optarg);
+        break;
+
+      case 'j':
+        parameters.threads = atoi(optarg);
+        break;
+
+      case 'r':
+        parameters.ranksPerNode = atoi(optarg);
+        break;
+
+      case 'q':
+        parameters.rowChunk = atoi(optarg);
+        break;
+
+      case 'L':
+        parameters.strategy = atoi(optarg);
+        break;
+
+      case 'C':
+        parameters.costModel = true;
+        break;
+
+      case 'E':
+        parameters.estimator = atoi(optarg);
+        break;
+
+      case 'H':
+        parameters.hysteresis = atoi(optarg);
+        break;
+
+      case 'G':
+        parameters.costGate = true;
+        break;
+
+      case 'B':
+        parameters.migrationBudget = atoi(optarg);
+        break;
+
+      case 'A':
+        parameters.asyncLag = atoi(optarg);
+        break;
+
+      case 'R':
+        parameters.nativeMigration = true;
+        break;
+
+      case 'N':
+        parameters.nodeAware = true;
+        break;
+
+      case 'P':
+        parameters.nodePlacement = true;
+        break;
+
       default:
         fprintf(stderr,"Wrong parameter!\n");
         PrintUsageAndExit();
     }
   } // while
 
-  MPI_Comm_size(MPI_COMM_WORLD, &(parameters.worldSize));
+  // threads per rank, node cores are split among ranks
+  if(parameters.threads == 0){
+
+    unsigned cores = std::thread::hardware_concurrency();
+
+    if(parameters.ranksPerNode > 0 && cores > 0)
+      parameters.threads = std::max<int>(1, cores / parameters.ranksPerNode);
+    else
+      parameters.threads = 1;
+  }
+
   // output enable flag
   parameters.ioEnabled = (parameters.outputFileName != "");
   if(! T_flag)
@@ -176,8 +297,20 @@ void ParseCommandline(int argc, char *argv[], TParameters &parameters)
     parameters.multiply = 1;
 
 
+  // halo zone width 2*D has to fit unsigned, tile edge is checked
+  // once the domain is loaded
+  parameters.temporalSteps = temporalSteps;
+
   if (!(n_flag && i_flag && w_flag && m_flag) || 
-      !(parameters.mode >= 0 && parameters.mode <= 2))
+      !(parameters.mode >= 0 && parameters.mode <= 2) ||
+      !(parameters.kernel >= KERNEL_SCALAR && parameters.kernel <= KERNEL_WEIGHTS) ||
+      temporalSteps <= 0 || temporalSteps > UINT_MAX / 2 ||
+      !(parameters.exchange >= DLB::EXCHANGE_AUTO && parameters.exchange <= DLB::EXCHANGE_RMA) ||
+      !(parameters.progress >= DLB::PROGRESS_NONE && parameters.progress <= DLB::PROGRESS_THREAD) ||
+      parameters.threads < 1 || parameters.ranksPerNode < 0 || parameters.rowChunk < 0 ||
+      !(parameters.strategy >= DLB::STRATEGY_WIDTHS && parameters.strategy <= DLB::STRATEGY_DIFFUSION) ||
+      !(parameters.estimator >= DLB::AVERAGE && parameters.estimator <= DLB::TREND) || parameters.hysteresis < 1 ||
+      parameters.migrationBudget < 0 || parameters.asyncLag < 0)
   {
     PrintUsageAndExit();
   }
@@ -201,7 +334,8 @@ bool VerifyResults(const float      *seqResult,
 {
   for (size_t i = 0; i < parameters.edgeSize * parameters.edgeSize; i++)
   {
-    if (fabs(parResult[i] - seqResult[i]) > epsilon)
+    // negated, NaN fails the comparison as well
+    if (!(fabs(parResult[i] - seqResult[i]) <= epsilon))
     {
       printf("Error found at position -> difference: ");
       printf("[%ld, %ld] -> %e\n", i / parameters.edgeSize, i % parameters.edgeSize,
@@ -243,6 +377,48 @@ void PrintUsageAndExit()
   fprintf(stderr,"  -b batch mode - output data in CSV format\n");
   fprintf(stderr,"  -M delay multiplier - float\n");
   fprintf(stderr,"  -T balancing threshold - float\n");
+  fprintf(stderr,"  -K [0-2]    compute kernel 0 - scalar, 1 - SIMD rows (default 1)\n");
+  fprintf(stderr,"              2 - SIMD rows with precomputed stencil weights\n");
+  fprintf(stderr,"  -D time steps per halo exchange (default 1), halo zone width is 2*D <= N\n");
+  fprintf(stderr,"  -e [0-5]    halo exchange 0 - Iscatterv per neighbor communicator (default)\n");
+  fprintf(stderr,"              1 - neighborhood collectives on graph communicator\n");
+  fprintf(stderr,"              2 - persistent point to point requests\n");
+  fprintf(stderr,"              3 - persistent point to point requests, zero-copy subarray types\n");
+  fprintf(stderr,"              4 - MPI-3 shared window on node, point to point between nodes\n");
+  fprintf(stderr,"              5 - one-sided MPI_Put into receive window, PSCW synchronization\n");
+  fprintf(stderr,"              auto - fastest of 0-5 by benchmark at startup\n");
+  fprintf(stderr,"  -g [0-2]    halo exchange progress 0 - in MPI_Waitall only (default)\n");
+  fprintf(stderr,"              1 - MPI_Testall polling between row chunks\n");
+  fprintf(stderr,"              2 - helper thread (MPI_THREAD_MULTIPLE), none with -e 5\n");
+  fprintf(stderr,"  -j threads per rank, tile is swept in row bands (default 1)\n");
+  fprintf(stderr,"  -r MPI ranks per node, threads per rank = cores / r if -j not set\n");
+  fprintf(stderr,"  -q rows per chunk, threads steal chunks of rows from each other\n");
+  fprintf(stderr,"     (default 0 - static row bands)\n");
+  fprintf(stderr,"  -L [0-5]    balancing strategy 0 - widths within fixed rows (default)\n");
+  fprintf(stderr,"              1 - heights of rows, then widths within rows\n");
+  fprintf(stderr,"              2 - Zoltan RCB, 3 - Zoltan RIB, 4 - Zoltan HSFC\n");
+  fprintf(stderr,"              (widths within rows if parts are not rectangles)\n");
+  fprintf(stderr,"              5 - diffusion, row neighbors move shared edges and rows\n");
+  fprintf(stderr,"              move their heights, no root, shifts are still allgathered\n");
+  fprintf(stderr,"              (globally synchronizing)\n");
+  fprintf(stderr,"  -C sample compute cost of every object once per balancing period,\n");
+  fprintf(stderr,"     cuts are placed by cost instead of object count\n");
+  fprintf(stderr,"  -E [0-3]    rank time estimator 0 - average (default), 1 - EWMA\n");
+  fprintf(stderr,"              2 - median with outlier rejection, 3 - linear trend\n");
+  fprintf(stderr,"  -H periods imbalance has to persist before migration, regular\n");
+  fprintf(stderr,"     layout is restored after the same number of balanced periods (default 1)\n");
+  fprintf(stderr,"  -G migrate only if predicted saving over remaining iterations\n");
+  fprintf(stderr,"     exceeds migration cost measured on previous migrations\n");
+  fprintf(stderr,"  -B objects moved per exchange step, larger repartition of row layouts\n");
+  fprintf(stderr,"     is spread over several steps (default 0 - unlimited)\n");
+  fprintf(stderr,"  -A static fields migrate in background, temperature is moved A iterations\n");
+  fprintf(stderr,"     after the decision (default 0 - off, overrides -B)\n");
+  fprintf(stderr,"  -R migration moves intersections of old and new tiles as subarrays\n");
+  fprintf(stderr,"     instead of Zoltan objects (default OFF)\n");
+  fprintf(stderr,"  -N node-aware balancing (-L 0/1), work moves between nodes only if\n");
+  fprintf(stderr,"     node loads are imbalanced, else between ranks of node (default OFF)\n");
+  fprintf(stderr,"  -P node-compact placement, ranks of node own block of regular mesh,\n");
+  fprintf(stderr,"     so halo neighbors share node (default OFF - ranks in rows)\n");
 
   
   exit(EXIT_FAILURE);
@@ -22,6 +22,8 @@
 #include <string>
 #include <mpi.h>
 
+#include "StencilKernels.h"
+
 #ifdef __AVX__
 /**
  * @var DATA_ALIGNMENT
@@ -80,13 +82,68 @@ struct TParameters
 
   double threshold; //imbalance detection threshold
 
+  /// Row kernel used by the parallel version (TKernel)
+  int kernel;
+
+  /// Time steps computed per halo exchange (halo zone width = 2 * temporalSteps)
+  unsigned temporalSteps;
+
+  /// Halo exchange backend (DLB::TExchange), -1 chosen at startup
+  int exchange;
+
+  /// Halo exchange progress (DLB::TProgress)
+  int progress;
+
+  /// Threads sweeping tile of every rank (row bands)
+  int threads;
+
+  /// MPI ranks per node, derives threads if not set explicitly (0 - unknown)
+  int ranksPerNode;
+
+  /// Rows per chunk of work stealing scheduler (0 - static row bands)
+  int rowChunk;
+
+  /// Repartitioning strategy (DLB::TStrategy)
+  int strategy;
+
+  /// Sample compute cost of every object once per balancing period
+  bool costModel;
+
+  /// Estimator of rank time from period history (DLB::AGR_METHOD)
+  int estimator;
+
+  /// Balancing periods imbalance has to persist before migration
+  int hysteresis;
+
+  /// Skip migrations not paying back before the end of simulation
+  bool costGate;
+
+  /// Objects moved by single migration step (0 - whole repartition at once)
+  int migrationBudget;
+
+  /// Iterations between decision and cutover of background migration (0 - off)
+  int asyncLag;
+
+  /// Migration moves tile intersections instead of Zoltan objects
+  bool nativeMigration;
+
+  /// Two level balancing, nodes first, then ranks of node
+  bool nodeAware;
+
+  /// Nodes get compact blocks of regular mesh instead of rows
+  bool nodePlacement;
+
   /// Default constructor
   TParameters() :
     nIterations(100000), edgeSize(0),
     diskWriteIntensity(1000), airFlowRate(0.001f), 
     materialFileName(""), outputFileName(""), mode(0),
     debugFlag(false), verificationFlag(false), sequentialFlag(false), 
-    batchMode(false), objDim(8), balance(false)
+    batchMode(false), objDim(8), balance(false), kernel(KERNEL_SIMD),
+    temporalSteps(1), exchange(0), progress(0), threads(0), ranksPerNode(0), rowChunk(0), strategy(0),
+    costModel(false), estimator(0), hysteresis(1), costGate(false),
+    migrationBudget(0), asyncLag(0), nativeMigration(false),
+    nodeAware(false), nodePlacement(false)
   {
     balancePeriod = (unsigned) (nIterations / 10); //default balance period
     threshold = 1.5;
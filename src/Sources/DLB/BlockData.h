@@ -43,7 +43,9 @@ class BlockData
 
 public:
 
-    BlockData() {}
+    BlockData():
+    weights(NULL)
+    {}
 
     BlockData(  float * oldTemp, float * newTemp, float * domParams, int * domMap,    // data arrays
                 int top, int bottom, int left, int right,  // block bounds
@@ -54,6 +56,7 @@ public:
     newTemp(newTemp),
     domParams(domParams),
     domMap(domMap),
+    weights(NULL),
     top(top),
     bottom(bottom),
     left(left),
@@ -73,6 +76,10 @@ public:
     float * oldTemp, * newTemp, *domParams;
     int * domMap;
 
+    // precomputed stencil weights (STENCIL_PLANES per row),
+    // NULL until DBD::updateWeights is called
+    float * weights;
+
     // data bounds
 
     unsigned top, bottom, left, right;
@@ -86,6 +93,11 @@ public:
     MPI_Comm myComm;
     int myCommRank;
 
+    // neighborhood collectives backend, arguments in order of neighbors
+    MPI_Comm graphComm;
+    vector<int> * nbrSendCounts, * nbrSendDispls;
+    vector<int> * nbrRecvCounts, * nbrRecvDispls;
+
     vector<int> * neighbors;
 
     map<int, Neighbor> * nData;
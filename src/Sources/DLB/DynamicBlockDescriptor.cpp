@@ -19,14 +19,24 @@
 using DBD = DLB::DynamicBlockDescriptor;
 using std::pair;
 using std::list;
+using std::set;
 
-DBD::DynamicBlockDescriptor(int rank, int worldSize,  size_t edgeSize, Dims objSize, double threshold):
+DBD::DynamicBlockDescriptor(int rank, int worldSize,  size_t edgeSize, Dims objSize, double threshold,
+                            unsigned haloSize, int exchange, int strategy, unsigned hysteresis,
+                            unsigned budget, unsigned asyncLag, bool native, bool nodeAware,
+                            bool placement):
 rank(rank),
 worldSize(worldSize),
 edgeSize(edgeSize),
-tdesc(rank, worldSize, edgeSize),
-lb(rank, edgeSize, worldSize, objSize, threshold),
-objectSize(objSize)
+haloSize(haloSize),
+tdesc(rank, worldSize, edgeSize, haloSize, exchange),
+lb(rank, edgeSize, worldSize, objSize, threshold, strategy, hysteresis, nodeAware),
+objectSize(objSize),
+placement(placement),
+migrationBudget(budget),
+nativeMigration(native),
+asyncLag(asyncLag),
+asyncLeft(0)
 {
 
     // bdata = tdesc.getBlockData();
@@ -46,6 +56,8 @@ objectSize(objSize)
         assignedObjsCnt = 0;
     }
 
+    lastMigBytes = migBytesTotal = migTimeTotal = 0.0;
+
     callbackDbg = false;
     oldArray = true;
 
@@ -61,6 +73,11 @@ objectSize(objSize)
 
     balanceSeq = 0;
 
+    rowComm = MPI_COMM_NULL;
+
+    weights = NULL;
+    weightsSize = 0;
+
 }
 
 DBD::~DynamicBlockDescriptor(void)
@@ -68,9 +85,16 @@ DBD::~DynamicBlockDescriptor(void)
 
   // oldTemp is returned as result
   // do not dealocate
+  // pending requests still refer to block arrays
+  asyncCancel();
+
+  if(rowComm != MPI_COMM_NULL)
+      MPI_Comm_free(&rowComm);
+
   delete[] bdata.newTemp;
   delete[] bdata.domMap;
   delete[] bdata.domParams;
+  delete[] weights;
 
 }
 
@@ -94,8 +118,15 @@ void DBD::zoltanInit(void)
     * Set params and callbacks
     */
 
-    // lb.zz->Set_Param("LB_METHOD", "RIB");
-    // lb.zz->Set_Param("RCB_RECTILINEAR_BLOCKS", "1");
+    if(lb.isGeometric()){
+
+        // geometric partitioner, objects weighted by measured time
+        lb.zz->Set_Param("LB_METHOD", lb.zoltanMethod());
+        lb.zz->Set_Param("OBJ_WEIGHT_DIM", "1");
+
+        // cuts across whole box, parts are rectangles
+        lb.zz->Set_Param("RCB_RECTILINEAR_BLOCKS", "1");
+    }
 
     // lb.zz->Set_Param("RCB_REUSE", "1");
    
@@ -140,6 +171,11 @@ void DBD::zoltanInit(void)
     lb.zz->Set_Fn(  ZOLTAN_PACK_OBJ_FN_TYPE,      (void (*)()) zolt_pack_obj_fn,    this);
     lb.zz->Set_Fn(  ZOLTAN_UNPACK_OBJ_FN_TYPE,    (void (*)()) zolt_unpack_obj_fn,  this);
 
+    // batched variants, used by Zoltan instead of the per object callbacks
+    lb.zz->Set_Fn(  ZOLTAN_OBJ_SIZE_MULTI_FN_TYPE,   (void (*)()) zolt_obj_size_multi_fn,   this);
+    lb.zz->Set_Fn(  ZOLTAN_PACK_OBJ_MULTI_FN_TYPE,   (void (*)()) zolt_pack_obj_multi_fn,   this);
+    lb.zz->Set_Fn(  ZOLTAN_UNPACK_OBJ_MULTI_FN_TYPE, (void (*)()) zolt_unpack_obj_multi_fn, this);
+
 }
 
 
@@ -156,39 +192,45 @@ void DBD::initNewBlock(TileDescriptor t)
 {
 
     newBlock.tile = t;
-    newBlock.temp = new float[newBlock.tile.getExtArea()];
-    newBlock.params = new float[newBlock.tile.getExtArea()];
-    newBlock.map = new int[newBlock.tile.getExtArea()];
+    newBlock.temp = new float[newBlock.tile.getExtArea(haloSize)];
+    newBlock.params = new float[newBlock.tile.getExtArea(haloSize)];
+    newBlock.map = new int[newBlock.tile.getExtArea(haloSize)];
 
-    for(unsigned i = 0; i < newBlock.tile.getExtArea(); i++ ){
+    Dims esize = newBlock.tile.getExtSize(haloSize);
 
-        newBlock.temp[i] = 0.0;
-        newBlock.params[i] = 0.0;
-        newBlock.map[i] = 0;
+    // first touch by rows, pages are placed near threads computing them
+    #pragma omp parallel for schedule(static)
+    for(int i = 0; i < (int) esize.y; i++ ){
+        for(unsigned j = 0; j < esize.x; j++){
 
+            newBlock.temp[i*esize.x + j] = 0.0;
+            newBlock.params[i*esize.x + j] = 0.0;
+            newBlock.map[i*esize.x + j] = 0;
+        }
     }
 
 }
 
 void DBD::initBlockData(const TMaterialProperties & data)
 {
-    unsigned earea = ( data.edgeSize + 4) * (data.edgeSize + 4);
+    unsigned earea = ( data.edgeSize + 2*haloSize) * (data.edgeSize + 2*haloSize);
 
     bdata.newTemp = new float[earea];
     bdata.oldTemp = new float[earea];
-    bdata.domParams = new float[earea];
-    bdata.domMap = new int[earea];
+    // halo zones outside domain are migrated with halo frames
+    bdata.domParams = new float[earea]();
+    bdata.domMap = new int[earea]();
 
     Dims d(data.edgeSize, data.edgeSize);
-    unsigned esize = data.edgeSize + 4;
+    unsigned esize = data.edgeSize + 2*haloSize;
 
     for(unsigned i = 0; i < d.y;i++){
         for(unsigned j = 0; j < d.x;j++){
 
-            bdata.newTemp[halo(j,i,esize)] = data.initTemp[i*d.x + j];
-            bdata.oldTemp[halo(j,i,esize)] = data.initTemp[i*d.x + j];
-            bdata.domParams[halo(j,i,esize)] = data.domainParams[i*d.x + j];
-            bdata.domMap[halo(j,i,esize)] = data.domainMap[i*d.x + j];
+            bdata.newTemp[halo(j,i,esize,haloSize)] = data.initTemp[i*d.x + j];
+            bdata.oldTemp[halo(j,i,esize,haloSize)] = data.initTemp[i*d.x + j];
+            bdata.domParams[halo(j,i,esize,haloSize)] = data.domainParams[i*d.x + j];
+            bdata.domMap[halo(j,i,esize,haloSize)] = data.domainMap[i*d.x + j];
         }
     }
 
@@ -208,6 +250,20 @@ DLB::BlockData DBD::loadInit(const TMaterialProperties & props )
 
     unsigned * rootObjs = new unsigned[objsPerBlock];
 
+    // nodes get compact blocks of regular mesh
+    if(placement){
+
+        TileDescriptor me;
+        int host = me.setHostNumber(TileDescriptor::getHostname());
+
+        vector<int> hosts(worldSize);
+
+        MPI_assert( MPI_Allgather(&host, 1, MPI_INT, hosts.data(), 1, MPI_INT, MPI_COMM_WORLD),
+                    "loadInit: Allgather failed" LOCATION );
+
+        lb.setHosts(hosts);
+    }
+
     // compute staic decomposition - regular mesh
     vector<TileDescriptor> * vtd = lb.regularTiles();
 
@@ -277,6 +333,9 @@ DLB::BlockData DBD::loadInit(const TMaterialProperties & props )
 
         tdesc.setTile(vtd->at(0));
 
+        // tiles were generated by root, host of this rank is sent with the tile
+        tdesc.tile().setHostNumber(TileDescriptor::getHostname());
+
 
         // new tile message
         TileMsg msg(vtd->at(0).getPosition(), vtd->at(0).getSize(), rank, tdesc.tile().getHostNumber());
@@ -308,6 +367,9 @@ DLB::BlockData DBD::loadInit(const TMaterialProperties & props )
     
         tdesc.setTile(vtd->at(rank));
 
+        // tiles were generated by root, host of this rank is sent with the tile
+        tdesc.tile().setHostNumber(TileDescriptor::getHostname());
+
         initNewBlock(vtd->at(rank));
 
         lb.num_import = gids.at(rank)->size();
@@ -407,29 +469,31 @@ void DBD::sortGIDs(unsigned * lst, unsigned objsPerBlock)
 }
 
 
-bool DBD::loadBalance(PerfMeasure & pm, BlockData & block)
+bool DBD::loadBalance(PerfMeasure & pm, BlockData & block, unsigned remaining)
 {
-    int balancing = 0;
-    bool restoreRegular = false;
+    // no root gather, buffers below are not needed
+    if(lb.isDiffusion()){
+
+        objCosts.clear();
+        return diffuse(pm, block);
+    }
+
+    int balancing = BALANCE_NONE;
     double * rbuf = new double[worldSize];
 
     TileMsg * tbuf = new TileMsg[worldSize];
 
-    list<unsigned> * persist = NULL;
     vector<TileDescriptor> *tls = NULL;
 
     vector<unsigned> sizes;
+    vector<double>  times;
 
     double time = pm.getAgreg();
 
     stringstream ss;
 
-    // if(rank == 0 || rank == 3)
-        // time *= 3;
     if(rank == 0){
 
-
-
         //collect times from other ranks
         MPI_assert( MPI_Gather( &time, 1, MPI_DOUBLE, 
                                 rbuf, 1, MPI_DOUBLE,
@@ -437,8 +501,6 @@ bool DBD::loadBalance(PerfMeasure & pm, BlockData & block)
                               ), 
                                 "loadBalance: root Gather failed" LOCATION );
 
-       
-
         // detect imbalance if occurs
         // send balancing info to others
         for(int i = 0; i < worldSize;i++){
@@ -450,7 +512,6 @@ bool DBD::loadBalance(PerfMeasure & pm, BlockData & block)
         // move to vector
         cout << "times_" << balanceSeq << ": ";
 
-        vector<double>  times;
         for(int i =0; i < worldSize;i++){
             times.push_back(rbuf[i]);
             cout << rbuf[i] << " ";
@@ -459,87 +520,129 @@ bool DBD::loadBalance(PerfMeasure & pm, BlockData & block)
 
         balanceSeq++;
 
-        if(lb.isBalanced(times)){
+        balancing = lb.decide(times, tdesc.getTiles());
 
-            if(lb.imbalance){ //actualy imbalance, recovering to regular
+    }else{
 
-                restoreRegular = true;
-                balancing = 1;
-                MPI_assert( MPI_Bcast(&balancing, 1, MPI_INT, 0, MPI_COMM_WORLD), "loadBalance bcast failed" LOCATION  );
-            }
+        // send measured performance
+        MPI_assert( MPI_Gather( &time, 1, MPI_DOUBLE,
+                                NULL, 0, MPI_DOUBLE, 
+                                0, MPI_COMM_WORLD ),
+                    
+                                "loadBalance: Gather failed" LOCATION );
+    }
 
-        }else{
+    MPI_assert( MPI_Bcast(&balancing, 1, MPI_INT, 0, MPI_COMM_WORLD), "loadBalance bcast failed" LOCATION );
 
-            balancing = 1;
-            restoreRegular = false;
-            MPI_assert( MPI_Bcast(&balancing, 1, MPI_INT, 0, MPI_COMM_WORLD), "loadBalance bcast failed" LOCATION );
-        }
+    if(balancing != BALANCE_NONE){
 
-        if(!balancing){
+        vector<double> costs;
 
-            // send no balancing
-            MPI_assert( MPI_Bcast(&balancing, 1 , MPI_INT, 0, MPI_COMM_WORLD), "loadBalance bcast failed" LOCATION  );
+        if(balancing == BALANCE_PARTITION)
+            costs = gatherCosts();
 
-        }else{
+        // geometric partitioners are collective,
+        // all ranks get the same tiles or NULL
+        if(balancing == BALANCE_PARTITION && lb.isGeometric())
+            tls = zoltanPartition(time);
+
+        if(tls == NULL){
+
+            if(rank == 0){
+
+                // obtain new  topology
+                if(balancing == BALANCE_REGULAR){
+
+                    tls = lb.regularTiles();
+
+                }else{
+
+                    tls = lb.getPartition(times, tdesc.getTiles(), costs);
+                }
 
-            // balancing = 1;
-            // lb.imbalance = true;
+                for(int i =0; i < worldSize;i++){  // new topology to send buffer
+                    tbuf[i] = tls->at(i).getData();
+                }
 
-            // MPI_assert( MPI_Bcast(&balancing, 1, MPI_INT, 0, MPI_COMM_WORLD), "loadBalance bcast failed" LOCATION );
+                // Bcast new topology to others
+                MPI_assert( MPI_Bcast(tbuf, worldSize, tdesc.TileMsg_t, 0, MPI_COMM_WORLD ), "topology Bcast failed" LOCATION);
 
-            // obtain new  topology
-            if(restoreRegular){
-                tls = lb.regularTiles();
-                lb.imbalance = false;
             }else{
-                tls = lb.getPartition(times, tdesc.getTiles());
-                lb.imbalance = true;
-            }
-                
-
-            if(DBG){
-                cout << COUTLOC;
-                ss << tls->at(rank);
-                ss << "assigned: ";
-                list<unsigned> * tmp = getAssignGIDs(tls->at(rank));
-                for(auto x : *tmp )
-                    ss << x << " ";
-                ss << endl;
-                cout << ss.str();
-                delete tmp;
-            }
 
+                MPI_assert( MPI_Bcast(tbuf, worldSize, tdesc.TileMsg_t, 0, MPI_COMM_WORLD ), "topology Bcast failed" LOCATION);
 
-            for(int i =0; i < worldSize;i++){  // new topology to send buffer
-                tbuf[i] = tls->at(i).getData();
+                tls = new vector<TileDescriptor>();
+
+                for(int i = 0; i < worldSize;i++){
+                    tls->push_back(TileDescriptor(tbuf[i]));
+                }
             }
 
+        }
 
-            // Bcast new topology to others
-            MPI_assert( MPI_Bcast(tbuf, worldSize, tdesc.TileMsg_t, 0, MPI_COMM_WORLD ), "topology Bcast failed" LOCATION);
-        
-            // set migration data            
-            persist = resolveMigration(tdesc.getTiles(), *tls);
+        if(rank == 0)
+            lastMigBytes = stallBytes(lb.movedObjects(tdesc.getTiles(), *tls));
 
-            // must be called before updateTopology
-            // callbackDbg = true;
-            migrate(*tls, *persist);
-            // callbackDbg = false;
+        // partition has to pay back before the end of simulation,
+        // first migration is always measured
+        if(remaining > 0 && balancing == BALANCE_PARTITION){
 
-            tdesc.setTiles(*tls);
+            int go = 1;
 
+            if(rank == 0){
 
-            
+                double saving = (*max_element(times.begin(), times.end())
+                                 - lb.predictMax(times, tdesc.getTiles(), *tls, costs)) * remaining;
+                double cost = migBytesTotal > 0.0 ? lastMigBytes * migTimeTotal / migBytesTotal : 0.0;
 
-            tdesc.updateTopology();
-            block = getBlockData();
+                go = saving > cost;
 
-            if(DBG){
-                cout << COUTLOC;
-                synCout(tdesc.commsToString(), rank, worldSize);
+                if(!go)
+                    cout << "skip_" << balanceSeq << ": saving " << saving << " cost " << cost << endl;
             }
 
+            MPI_assert( MPI_Bcast(&go, 1, MPI_INT, 0, MPI_COMM_WORLD), "loadBalance gate bcast failed" LOCATION );
+
+            if(!go)
+                balancing = BALANCE_NONE;
         }
+    }
+
+    if(balancing != BALANCE_NONE){
+
+        if(rank == 0)
+            lb.imbalance = balancing == BALANCE_PARTITION;
+
+        if(DBG){
+            ss << tls->at(rank);
+            ss << "assigned: ";
+            list<unsigned> * tmp = getAssignGIDs(tls->at(rank));
+            for(auto x : *tmp )
+                ss << x << " ";
+            ss << endl;
+            cout << ss.str();
+            delete tmp;
+        }
+
+        // static fields are shipped in background, old topology keeps computing
+        if(asyncLag > 0){
+
+            asyncStart(*tls);
+            balancing = BALANCE_NONE;
+
+        // large repartition is spread over several steps
+        }else if(migrationBudget > 0 && lb.isRowLayout(tdesc.getTiles()) && lb.isRowLayout(*tls)){
+
+            pendingTiles = *tls;
+            migrateStep(block);
+
+        }else{
+
+            applyTiles(*tls, block);
+        }
+    }
+
+    if(rank == 0){
 
         cout << "sizes_" << balanceSeq << ": ";
         for(int i = 0; i < worldSize;i++){
@@ -548,81 +651,590 @@ bool DBD::loadBalance(PerfMeasure & pm, BlockData & block)
             cout << tmp << " ";
         }       
         cout << endl;
+    }
 
+    delete[] rbuf;
+    delete[] tbuf;
 
-        // MPI_assert(MPI_Barrier(MPI_COMM_WORLD), "loadBalance: sync before partition" LOCATION);
-        // call load balance
+    if(tls != NULL) delete tls;
 
-    }else{
+    // tile may change, costs are sampled again in next period
+    objCosts.clear();
+
+    return balancing != BALANCE_NONE;
+}
 
 
-        // send measured performance
-        MPI_assert( MPI_Gather( &time, 1, MPI_DOUBLE,
-                                NULL, 0, MPI_DOUBLE, 
-                                0, MPI_COMM_WORLD ),
-                    
-                                "loadBalance: Gather failed" LOCATION );
+bool DBD::diffuse(PerfMeasure & pm, BlockData & block)
+{
+    const vector<TileDescriptor> & tiles = tdesc.getTiles();
+    const TileDescriptor & me = *find(tiles.begin(), tiles.end(), rank);
+
+    // neighbors in row of slots, ranks of row may be placed
+    // in any order (LoadBalancer::setHosts)
+    int left = lb.leftOf(rank);
+    int right = lb.rightOf(rank);
+
+    int above = lb.aboveOf(rank);
+    int below = lb.belowOf(rank);
+
+    double mine[2] = {pm.getAgreg(), (double) (me.getSize().x / objectSize.x)};
+    double fromLeft[2], fromRight[2];
+
+    MPI_assert( MPI_Sendrecv(mine, 2, MPI_DOUBLE, right, TAG_DIFFUSION,
+                             fromLeft, 2, MPI_DOUBLE, left, TAG_DIFFUSION, MPI_COMM_WORLD, MPI_STATUS_IGNORE),
+                "diffuse: Sendrecv failed" LOCATION );
+
+    MPI_assert( MPI_Sendrecv(mine, 2, MPI_DOUBLE, left, TAG_DIFFUSION,
+                             fromRight, 2, MPI_DOUBLE, right, TAG_DIFFUSION, MPI_COMM_WORLD, MPI_STATUS_IGNORE),
+                "diffuse: Sendrecv failed" LOCATION );
+
+    // time of row of tiles once its widths are balanced,
+    // objects of single object row over their summed performance
+    if(rowComm == MPI_COMM_NULL)
+        MPI_assert( MPI_Comm_split(MPI_COMM_WORLD, lb.rowOf(rank), rank, &rowComm),
+                    "diffuse: Comm_split failed" LOCATION );
+
+    double work[2] = {mine[1], mine[1] / mine[0]};
+    double row[2];
+
+    MPI_assert( MPI_Allreduce(work, row, 2, MPI_DOUBLE, MPI_SUM, rowComm),
+                "diffuse: Allreduce failed" LOCATION );
+
+    double band[2] = {row[0] / row[1], (double) (me.getSize().y / objectSize.y)};
+    double fromAbove[2], fromBelow[2];
+
+    MPI_assert( MPI_Sendrecv(band, 2, MPI_DOUBLE, below, TAG_DIFFUSION,
+                             fromAbove, 2, MPI_DOUBLE, above, TAG_DIFFUSION, MPI_COMM_WORLD, MPI_STATUS_IGNORE),
+                "diffuse: Sendrecv failed" LOCATION );
+
+    MPI_assert( MPI_Sendrecv(band, 2, MPI_DOUBLE, above, TAG_DIFFUSION,
+                             fromBelow, 2, MPI_DOUBLE, below, TAG_DIFFUSION, MPI_COMM_WORLD, MPI_STATUS_IGNORE),
+                "diffuse: Sendrecv failed" LOCATION );
+
+    // this rank owns its right edge, its row owns the bottom edge,
+    // all ranks of row compute the same vertical shift
+    int shift[2] = {0, 0};
+
+    if(right != MPI_PROC_NULL)
+        shift[0] = lb.edgeShift(mine[0], mine[1], fromRight[0], fromRight[1]);
+
+    if(below != MPI_PROC_NULL)
+        shift[1] = lb.edgeShift(band[0], band[1], fromBelow[0], fromBelow[1]);
+
+    // horizontal and vertical shift of every rank
+    vector<int> shifts(2 * worldSize);
+
+    MPI_assert( MPI_Allgather(shift, 2, MPI_INT, shifts.data(), 2, MPI_INT, MPI_COMM_WORLD),
+                "diffuse: Allgather failed" LOCATION );
+
+    balanceSeq++;
+
+    if(all_of(shifts.begin(), shifts.end(), [](int s){ return s == 0; }))
+        return false;
+
+    // every rank applies the same shifts to its copy of tile table
+    vector<TileDescriptor> tls;
+
+    vector<TileDescriptor> byRank(worldSize);
+
+    for(auto & t : tiles)
+        byRank[t.getRank()] = t;
+
+    for(int r = 0; r < worldSize; r++){
+
+        TileDescriptor t = byRank[r];
+
+        Dims p = t.getPosition();
+        Dims s = t.getSize();
+
+        int l = lb.leftOf(r);
+        int a = lb.aboveOf(r);
+
+        if(l != MPI_PROC_NULL){
+            p.x += shifts[2*l] * (int) objectSize.x;
+            s.x -= shifts[2*l] * (int) objectSize.x;
+        }
 
-        MPI_assert( MPI_Bcast(&balancing, 1, MPI_INT, 0, MPI_COMM_WORLD), "loadBalance bcast failed" LOCATION );
+        if(a != MPI_PROC_NULL){
+            p.y += shifts[2*a + 1] * (int) objectSize.y;
+            s.y -= shifts[2*a + 1] * (int) objectSize.y;
+        }
+
+        s.x += shifts[2*r] * (int) objectSize.x;
+        s.y += shifts[2*r + 1] * (int) objectSize.y;
+
+        t.setPosition(p);
+        t.setSize(s);
+        tls.push_back(t);
+    }
+
+    applyTiles(tls, block);
+
+    if(rank == 0){
+
+        cout << "sizes_" << balanceSeq << ": ";
+        for(int i = 0; i < worldSize;i++){
+            auto it = find(tdesc.getTiles().begin(), tdesc.getTiles().end(), i);
+            cout << (*it).getSize().x / objectSize.x << " ";
+        }
+        cout << endl;
+    }
+
+    return true;
+}
+
+
+void DBD::applyTiles(const vector<TileDescriptor> & tls, BlockData & block)
+{
+    if(nativeMigration){
+
+        migrateRects(tls);
+
+        tdesc.setTiles(tls);
+        tdesc.updateTopology();
+
+        block = getBlockData();
+
+        if(DBG)  synCout(tdesc.commsToString(), rank, worldSize);
+
+        return;
+    }
+
+    // set migration data
+    list<unsigned> * persist = resolveMigration(tdesc.getTiles(), tls);
+
+    // must be called before updateTopology
+    migrate(tls, *persist);
 
-        if(balancing == 1){
-            // perform balancing
+    tdesc.setTiles(tls);
+    tdesc.updateTopology();
 
-            MPI_assert( MPI_Bcast(tbuf, worldSize, tdesc.TileMsg_t, 0, MPI_COMM_WORLD ), "topology Bcast failed" LOCATION);
-            vector<TileDescriptor> vtd;
+    block = getBlockData();
 
-            for(int i = 0; i < worldSize;i++){
-                vtd.push_back(TileDescriptor(tbuf[i]));
+    delete persist;
+
+    if(DBG)  synCout(tdesc.commsToString(), rank, worldSize);
+}
+
+
+bool DBD::migrateStep(BlockData & block)
+{
+    if(pendingTiles.empty())
+        return false;
+
+    bool last;
+    vector<TileDescriptor> * step = lb.budgetStep(tdesc.getTiles(), pendingTiles, migrationBudget, last);
+
+    if(rank == 0)
+        lastMigBytes = lb.movedObjects(tdesc.getTiles(), *step) * (double) getObjBytes();
+
+    applyTiles(*step, block);
+
+    if(last)
+        pendingTiles.clear();
+
+    delete step;
+
+    return true;
+}
+
+
+void DBD::adoptNewBlock(void)
+{
+    delete[] bdata.newTemp;
+    delete[] bdata.oldTemp;
+    delete[] bdata.domParams;
+    delete[] bdata.domMap;
+
+    bdata.oldTemp = newBlock.temp;
+    // make new arrays actual
+    bdata.newTemp = new float[newBlock.tile.getExtArea(haloSize)];
+    #pragma omp parallel for schedule(static)
+    for(int i = 0; i < (int) newBlock.tile.getExtArea(haloSize);i++){
+        bdata.newTemp[i] = bdata.oldTemp[i];
+    }
+    bdata.domParams = newBlock.params;
+    bdata.domMap = newBlock.map;
+
+    newBlock.temp = NULL;
+    newBlock.params = NULL;
+    newBlock.map = NULL;
+}
+
+
+// rectangle <x0, x1) x <y0, y1) in domain coordinates
+struct Rect { int x0, y0, x1, y1; };
+
+static Rect tileRect(const DLB::TileDescriptor & t, int grow)
+{
+    DLB::Dims p = t.getPosition();
+    DLB::Dims s = t.getSize();
+
+    return Rect{ (int) p.x - grow, (int) p.y - grow, (int) (p.x + s.x) + grow, (int) (p.y + s.y) + grow };
+}
+
+static Rect intersect(const Rect & a, const Rect & b)
+{
+    return Rect{ std::max(a.x0, b.x0), std::max(a.y0, b.y0), std::min(a.x1, b.x1), std::min(a.y1, b.y1) };
+}
+
+// subarray of rectangle in extended block of tile
+static MPI_Datatype rectType(const Rect & r, const DLB::TileDescriptor & t, unsigned halo, MPI_Datatype base)
+{
+    DLB::Dims e = t.getExtSize(halo);
+    DLB::Dims p = t.getPosition();
+
+    int sizes[2] = { (int) e.y, (int) e.x };
+    int subsizes[2] = { r.y1 - r.y0, r.x1 - r.x0 };
+    int starts[2] = { r.y0 - (int) p.y + (int) halo, r.x0 - (int) p.x + (int) halo };
+
+    MPI_Datatype type;
+
+    DLB::MPI_assert( MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, base, &type),
+                     "rectType: subarray failed" LOCATION );
+    DLB::MPI_assert( MPI_Type_commit(&type), "rectType: commit failed" LOCATION );
+
+    return type;
+}
+
+
+void DBD::postRects(const vector<TileDescriptor> & tls, int grow, bool temp)
+{
+    // both layouts are ordered by rank
+    const vector<TileDescriptor> & old = tdesc.getTiles();
+
+    const TileDescriptor & mineOld = old[rank];
+    const TileDescriptor & mineNew = tls[rank];
+
+    Rect want = tileRect(mineNew, grow);
+    Rect have = tileRect(mineOld, 0);
+
+    for(int r = 0; r < worldSize; r++){
+
+        // part of new tile held by r, in-domain points only
+        Rect in = intersect(want, tileRect(old[r], 0));
+
+        // part of old tile needed by r
+        Rect out = intersect(have, tileRect(tls[r], grow));
+
+        if(in.x0 < in.x1 && in.y0 < in.y1){
+
+            vector<std::pair<MPI_Datatype, void *>> recv;
+
+            if(temp){
+                recv.push_back({rectType(in, mineNew, haloSize, MPI_FLOAT), newBlock.temp});
+            }else{
+                recv.push_back({rectType(in, mineNew, haloSize, MPI_FLOAT), newBlock.params});
+                recv.push_back({rectType(in, mineNew, haloSize, MPI_INT), newBlock.map});
             }
 
-            if(DBG){
-                ss << vtd.at(rank);
-                ss << "assigned: ";
-                list<unsigned> * tmp = getAssignGIDs(vtd.at(rank));
-                for(auto x : *tmp )
-                    ss << x << " ";
-                ss << endl;
-                cout << ss.str();
-                delete tmp;
-            }   
+            for(unsigned i = 0; i < recv.size(); i++){
+
+                rectRequests.push_back(MPI_REQUEST_NULL);
+                rectTypes.push_back(recv[i].first);
 
+                MPI_assert( MPI_Irecv(recv[i].second, 1, recv[i].first, r,
+                                      temp ? TAG_RECT_TEMP : (i == 0 ? TAG_RECT_PARAMS : TAG_RECT_MAP),
+                                      MPI_COMM_WORLD, &rectRequests.back()),
+                            "postRects: Irecv failed" LOCATION );
+            }
+        }
 
-            persist = resolveMigration(tdesc.getTiles(), vtd);
+        if(out.x0 < out.x1 && out.y0 < out.y1){
 
-            // callbackDbg = true;
-            migrate(vtd, *persist);
-            // callbackDbg = false;
+            vector<std::pair<MPI_Datatype, void *>> send;
 
+            if(temp){
+                send.push_back({rectType(out, mineOld, haloSize, MPI_FLOAT), bdata.oldTemp});
+            }else{
+                send.push_back({rectType(out, mineOld, haloSize, MPI_FLOAT), bdata.domParams});
+                send.push_back({rectType(out, mineOld, haloSize, MPI_INT), bdata.domMap});
+            }
 
-            tdesc.setTiles(vtd);
-            
-            if(DBG && rank == 1){
+            for(unsigned i = 0; i < send.size(); i++){
 
-                cout << COUTLOC;
-                cout << tdesc.toString();
+                rectRequests.push_back(MPI_REQUEST_NULL);
+                rectTypes.push_back(send[i].first);
+
+                MPI_assert( MPI_Isend(send[i].second, 1, send[i].first, r,
+                                      temp ? TAG_RECT_TEMP : (i == 0 ? TAG_RECT_PARAMS : TAG_RECT_MAP),
+                                      MPI_COMM_WORLD, &rectRequests.back()),
+                            "postRects: Isend failed" LOCATION );
             }
+        }
+    }
+}
 
-            tdesc.updateTopology();
 
-            block = getBlockData();
+void DBD::waitRects(void)
+{
+    MPI_assert( MPI_Waitall(rectRequests.size(), rectRequests.data(), MPI_STATUSES_IGNORE),
+                "waitRects: Waitall failed" LOCATION );
 
-            if(DBG)  synCout(tdesc.commsToString(), rank, worldSize);
+    for(auto & t : rectTypes)
+        MPI_Type_free(&t);
 
-        } //end imbalance 1
+    rectRequests.clear();
+    rectTypes.clear();
+}
 
 
-    } // else end
+void DBD::migrateRects(const vector<TileDescriptor> & tls)
+{
+    auto r = find(begin(tls), end(tls), rank);
 
-    delete[] rbuf;
-    delete[] tbuf;
+    if(r == end(tls)) throw runtime_error("migrateRects: rank not found in tiles");
 
-    if(tls != NULL) delete tls;
-    if(persist != NULL) delete persist;
+    initNewBlock(*r);
+
+    // static fields with halo zones, temperature of interior
+    postRects(tls, haloSize, false);
+    postRects(tls, 0, true);
+
+    waitRects();
+
+    adoptNewBlock();
+}
+
+
+void DBD::asyncStart(const vector<TileDescriptor> & tls)
+{
+    asyncTiles = tls;
+    asyncLeft = asyncLag;
 
+    initNewBlock(*find(tls.begin(), tls.end(), rank));
 
-    return (bool) balancing;
-  
-    // block = ();
+    postRects(tls, haloSize, false);
+}
+
+
+void DBD::asyncProgress(void)
+{
+    if(!asyncPending())
+        return;
+
+    if(asyncLeft > 0)
+        asyncLeft--;
+
+    int flag;
+
+    MPI_assert( MPI_Testall(rectRequests.size(), rectRequests.data(), &flag, MPI_STATUSES_IGNORE),
+                "asyncProgress: Testall failed" LOCATION );
+}
+
+
+bool DBD::asyncCutover(BlockData & block)
+{
+    if(!asyncPending())
+        return false;
+
+    // temperature of new tile, halo zones are exchanged after topology update
+    postRects(asyncTiles, 0, true);
+
+    waitRects();
+
+    if(rank == 0)
+        lastMigBytes = stallBytes(lb.movedObjects(tdesc.getTiles(), asyncTiles));
+
+    adoptNewBlock();
+
+    tdesc.setTiles(asyncTiles);
+    tdesc.updateTopology();
+
+    block = getBlockData();
+
+    asyncTiles.clear();
+
+    return true;
+}
+
+
+void DBD::asyncCancel(void)
+{
+    if(!asyncPending())
+        return;
+
+    waitRects();
+
+    delete[] newBlock.temp;
+    delete[] newBlock.params;
+    delete[] newBlock.map;
+
+    newBlock.temp = NULL;
+    newBlock.params = NULL;
+    newBlock.map = NULL;
+
+    asyncTiles.clear();
+}
+
+
+unsigned DBD::getObjBytes(void) const
+{
+    Dims frame = getFrameSize();
+
+    return objectSize.x * objectSize.y * sizeof(float) + frame.x * frame.y * (sizeof(float) + sizeof(int));
+}
+
+
+double DBD::stallBytes(unsigned objects) const
+{
+    if(asyncLag > 0)
+        return objects * (double) (objectSize.x * objectSize.y * sizeof(float));
+
+    return objects * (double) getObjBytes();
+}
+
+
+float * DBD::getObjCosts(void)
+{
+    Dims s = tdesc.tile().getSize();
+
+    objCosts.assign((s.x / objectSize.x) * (s.y / objectSize.y), 0.0f);
+
+    return objCosts.data();
+}
+
+
+vector<double> DBD::gatherCosts(void)
+{
+    int cnt = objCosts.size();
+
+    vector<int> cnts(worldSize), displs(worldSize);
+    vector<float> all;
+    vector<double> costs;
+
+    MPI_assert( MPI_Gather(&cnt, 1, MPI_INT, cnts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD),
+                "gatherCosts: Gather failed" LOCATION );
+
+    if(rank == 0){
+
+        for(int i = 1; i < worldSize; i++)
+            displs[i] = displs[i-1] + cnts[i-1];
+
+        all.resize(displs[worldSize-1] + cnts[worldSize-1]);
+    }
+
+    MPI_assert( MPI_Gatherv(objCosts.data(), cnt, MPI_FLOAT,
+                            all.data(), cnts.data(), displs.data(), MPI_FLOAT,
+                            0, MPI_COMM_WORLD),
+                "gatherCosts: Gatherv failed" LOCATION );
+
+    if(rank != 0)
+        return costs;
+
+    costs.assign(rows * cols, 0.0);
+
+    for(int i = 0; i < worldSize; i++){
+
+        const TileDescriptor & t = *find(tdesc.getTiles().begin(), tdesc.getTiles().end(), i);
+
+        Dims p = t.getPosition();
+        Dims s = t.getSize();
+
+        unsigned w = s.x / objectSize.x;
+        unsigned h = s.y / objectSize.y;
+
+        // tile not sampled, costs are not comparable
+        if(cnts[i] != (int) (w * h))
+            return vector<double>();
+
+        for(unsigned y = 0; y < h; y++)
+            for(unsigned x = 0; x < w; x++)
+                costs[(p.y / objectSize.y + y) * cols + p.x / objectSize.x + x] = all[displs[i] + y * w + x];
+    }
+
+    return costs;
+}
+
+
+vector<DLB::TileDescriptor> * DBD::zoltanPartition(double time)
+{
+    int changes, numGid, numLid;
+    int numImport, numExport;
+    ZOLTAN_ID_PTR importGids, importLids, exportGids, exportLids;
+    int *importProcs, *importParts, *exportProcs, *exportParts;
+
+    list<unsigned> * mine = getAssignGIDs();
+
+    // objects of slow rank are heavier, measured time is split
+    // by sampled costs if available
+    float sum = accumulate(objCosts.begin(), objCosts.end(), 0.0f);
+
+    objWeights.assign(mine->size(), mine->empty() ? 0.0f : time / mine->size());
+
+    if(objCosts.size() == mine->size() && sum > 0.0f){
+        for(unsigned i = 0; i < objCosts.size(); i++)
+            objWeights[i] = time * objCosts[i] / sum;
+    }
+
+    int rc = lb.zz->LB_Partition(changes, numGid, numLid,
+                                 numImport, importGids, importLids, importProcs, importParts,
+                                 numExport, exportGids, exportLids, exportProcs, exportParts);
+
+    // objects assigned to this rank in new partition
+    set<unsigned> assigned(mine->begin(), mine->end());
+    delete mine;
+
+    if(rc == ZOLTAN_OK || rc == ZOLTAN_WARN){
+
+        for(int i = 0; i < numExport; i++)
+            assigned.erase(exportGids[i]);
+
+        for(int i = 0; i < numImport; i++)
+            assigned.insert(importGids[i]);
+
+        Zoltan::LB_Free_Part(&importGids, &importLids, &importProcs, &importParts);
+        Zoltan::LB_Free_Part(&exportGids, &exportLids, &exportProcs, &exportParts);
+    }
+
+    // bounding box of assigned objects: min x, min y, max x, max y, count, status
+    int box[6] = {(int) cols, (int) rows, -1, -1, (int) assigned.size(), rc == ZOLTAN_OK || rc == ZOLTAN_WARN};
+
+    for(auto gid : assigned){
+
+        Dims pos = getCoordsByGID(gid);
+
+        box[0] = std::min<int>(box[0], pos.x / objectSize.x);
+        box[1] = std::min<int>(box[1], pos.y / objectSize.y);
+        box[2] = std::max<int>(box[2], pos.x / objectSize.x);
+        box[3] = std::max<int>(box[3], pos.y / objectSize.y);
+    }
+
+    vector<int> boxes(6 * worldSize);
+
+    MPI_assert( MPI_Allgather(box, 6, MPI_INT, boxes.data(), 6, MPI_INT, MPI_COMM_WORLD),
+                "zoltanPartition: Allgather failed" LOCATION );
+
+    // parts are disjoint, every part filling its bounding box is rectangle
+    for(int i = 0; i < worldSize; i++){
+
+        int * b = &(boxes[6*i]);
+
+        if(!b[5] || b[4] == 0 || (b[2] - b[0] + 1) * (b[3] - b[1] + 1) != b[4]){
+
+            if(rank == 0)
+                cout << "zoltanPartition: " << lb.zoltanMethod() << " part " << i << " not rectangle, using widths" << endl;
+
+            return NULL;
+        }
+    }
+
+    vector<TileDescriptor> * tls = new vector<TileDescriptor>();
+
+    for(int i = 0; i < worldSize; i++){
+
+        int * b = &(boxes[6*i]);
+
+        TileDescriptor t = *find(tdesc.getTiles().begin(), tdesc.getTiles().end(), i);
+
+        t.setPosition(Dims(b[0] * objectSize.x, b[1] * objectSize.y));
+        t.setSize(Dims((b[2] - b[0] + 1) * objectSize.x, (b[3] - b[1] + 1) * objectSize.y));
+
+        tls->push_back(t);
+    }
+
+    return tls;
 }
 
 
@@ -997,7 +1609,7 @@ string DBD::toString(void)
     ss << "Neighbors: " << bdata.neighbors->size() << endl;
     ss << "blockSize " << tdesc.tile().getSize() << endl;
     ss << "blockPosition " << tdesc.tile().getPosition() << endl; 
-    ss << "extSize " << tdesc.tile().getExtSize() << endl;
+    ss << "extSize " << getExtSize() << endl;
     
     ss << "Bounds: [T,R,B,L]" << "[" << bdata.top << ", " << bdata.right << ", ";
     ss << bdata.bottom << ", " << bdata.left << "]" << endl;
@@ -1037,6 +1649,7 @@ DLB::BlockData DBD::getBlockData(void)
    b.newTemp = bdata.newTemp;
    b.domParams = bdata.domParams;
    b.domMap = bdata.domMap;
+   b.weights = bdata.weights;
 
    //store bdata as attribute
    bdata = b; 
@@ -1048,14 +1661,21 @@ DLB::BlockData DBD::getBlockData(void)
 /**
  * @brief Returns length of halo zones
  * 
- * @return [description]
+ * @return number of points sufficient for both send and receive buffer
  */
 
+DLB::BlockData DBD::setExchange(int exchange)
+{
+    tdesc.setExchange(exchange);
+    tdesc.updateTopology();
+
+    return getBlockData();
+}
+
+
 unsigned DBD::getHaloLen(void)
 { 
-    Dims tmp = tdesc.tile().getSize();
-
-    return 2*tmp.x + 2*tmp.y;
+    return tdesc.getHaloLen();
 }
 
 
@@ -1114,9 +1734,11 @@ void DBD::movePersistObj(const list<unsigned> & persist, bool init, bool collect
         // dont have any previous data
         // eg. BlockData are not initialized
         bdata.oldTemp = newBlock.temp;
-        bdata.newTemp = new float[newBlock.tile.getExtArea()];
+        bdata.newTemp = new float[newBlock.tile.getExtArea(haloSize)];
 
-        for(unsigned i = 0; i < newBlock.tile.getExtArea();i++){
+        // first touch in contiguous bands, as in initNewBlock
+        #pragma omp parallel for schedule(static)
+        for(int i = 0; i < (int) newBlock.tile.getExtArea(haloSize);i++){
             bdata.newTemp[i] = bdata.oldTemp[i];
         }
 
@@ -1134,7 +1756,7 @@ void DBD::movePersistObj(const list<unsigned> & persist, bool init, bool collect
         // vector<unsigned> * objs = getAssignedObjs();
 
         Dims relOld, relNew;
-        Dims esizeOld = tdesc.tile().getExtSize();
+        Dims esizeOld = getExtSize();
         Dims esizeNew;
 
         if(collect){
@@ -1147,7 +1769,7 @@ void DBD::movePersistObj(const list<unsigned> & persist, bool init, bool collect
                 for(unsigned i = 0; i < objectSize.y;i++){
                     for(unsigned j = 0 ; j < objectSize.x;j++){
                         // resolve coordinates relative to block icncluding halo zones
-                        unsigned oldIdx = halo( relOld.x + j, relOld.y + i, esizeOld.x);
+                        unsigned oldIdx = halo( relOld.x + j, relOld.y + i, esizeOld.x, haloSize);
 
                         // resArray without halo zones
                         unsigned newIdx = (objPos.y + i) * edgeSize + (objPos.x + j);
@@ -1165,7 +1787,7 @@ void DBD::movePersistObj(const list<unsigned> & persist, bool init, bool collect
 
         }else{
 
-            Dims esizeNew = newBlock.tile.getExtSize();
+            Dims esizeNew = newBlock.tile.getExtSize(haloSize);
 
             for(auto obj : persist){
     
@@ -1175,38 +1797,53 @@ void DBD::movePersistObj(const list<unsigned> & persist, bool init, bool collect
                 for(unsigned i = 0; i < objectSize.y;i++){
                     for(unsigned j = 0 ; j < objectSize.x;j++){
                         // resolve coordinates relative to block icncluding halo zones
-                        unsigned oldIdx = halo( relOld.x + j, relOld.y + i, esizeOld.x);
-                        unsigned newIdx = halo( relNew.x + j, relNew.y + i, esizeNew.x); 
+                        unsigned oldIdx = halo( relOld.x + j, relOld.y + i, esizeOld.x, haloSize);
+                        unsigned newIdx = halo( relNew.x + j, relNew.y + i, esizeNew.x, haloSize); 
                           // move data from old arrays to new ones
                         newBlock.temp[newIdx] = bdata.oldTemp[oldIdx];
-                        newBlock.params[newIdx] = bdata.domParams[oldIdx];
-                        newBlock.map[newIdx] = bdata.domMap[oldIdx];
                     }
                 }
+
+                // static fields including halo frame, as in zolt_pack_obj_fn
+                Dims frame = getFrameSize();
+
+                for(unsigned i = 0; i < frame.y;i++){
+
+                    unsigned oldIdx = (relOld.y + i) * esizeOld.x + relOld.x;
+                    unsigned newIdx = (relNew.y + i) * esizeNew.x + relNew.x;
+
+                    std::memcpy(&(newBlock.params[newIdx]), &(bdata.domParams[oldIdx]), frame.x*sizeof(float));
+                    std::memcpy(&(newBlock.map[newIdx]), &(bdata.domMap[oldIdx]), frame.x*sizeof(int));
+                }
             }
 
             // copy persistent objects
            
             // delete old array, actual are in new block
-            delete[] bdata.newTemp;
-            delete[] bdata.oldTemp;
-            delete[] bdata.domParams;
-            delete[] bdata.domMap;
-    
-            bdata.oldTemp = newBlock.temp;
-            // make new arrays actual
-            bdata.newTemp = new float[newBlock.tile.getExtArea()];
-            for(unsigned i = 0; i < newBlock.tile.getExtArea();i++){
-                bdata.newTemp[i] = bdata.oldTemp[i];
-            }
-            bdata.domParams = newBlock.params;
-            bdata.domMap = newBlock.map;
-    
+            adoptNewBlock();
         }
     }
 
 }
 
+void DBD::updateWeights(BlockData & block, float airFlowRate, float coolerTemp)
+{
+    Dims ext = getExtSize();
+    unsigned size = STENCIL_PLANES * ext.x * ext.y;
+
+    if(size != weightsSize){
+        delete[] weights;
+        weights = new float[size];
+        weightsSize = size;
+    }
+
+    BuildStencilWeights(bdata.domParams, bdata.domMap, weights,
+                        ext.x, ext.y, airFlowRate, coolerTemp);
+
+    bdata.weights = weights;
+    block.weights = weights;
+}
+
 /**
  * @brief [brief description]
  * @details [long description]
@@ -1222,7 +1859,7 @@ float DBD::middleColAvg(void)
     float avg = 0.0;
     for(unsigned i = 0; i < tdesc.tile().getSize().y; i++){
 
-        avg += bdata.newTemp[ halo(offset, i, tdesc.tile().getExtSize().x) ];
+        avg += bdata.newTemp[ halo(offset, i, getExtSize().x, haloSize) ];
     }
 
     // avg = avg / tdesc.tile().getSize().y;
@@ -1244,7 +1881,10 @@ float DBD::middleColAvg(void)
 int DBD::zolt_num_obj_fn(void * data, int * err)
 {
     unused(err);
-    return ((DynamicBlockDescriptor *) data)->assignedObjsCnt;
+    DynamicBlockDescriptor * dbd = (DynamicBlockDescriptor *) data;
+    Dims s = dbd->tdesc.tile().getSize();
+
+    return (s.x / dbd->objectSize.x) * (s.y / dbd->objectSize.y);
 }
 
 
@@ -1373,14 +2013,15 @@ int DBD::zolt_obj_size_fn(void * data,
 
     }else{
 
-        return 2*(objarea * sizeof(float)) + (objarea * sizeof(int));
+        return p->getObjBytes();
     }
 
 }
 
 /**
  * @brief Extract data object from actual block
- * @detailed Reads data from oldTemp array
+ * @detailed Reads data from oldTemp array, static fields
+ * 			are packed with halo frame (see getFrameSize)
  * 
  */
 
@@ -1411,128 +2052,118 @@ void DBD::zolt_pack_obj_fn( void * data,
 
     if(dbd->callbackDbg) cout << "rank "  << dbd->getRank() << " pack: " << *global_id << endl;
 
-    Dims esize = dbd->tdesc.tile().getExtSize();
-    Dims blockPos = dbd->tdesc.tile().getPosition();
-
-    Dims objPos = dbd->getCoordsByGID(*global_id);
-
-    Dims rel = objPos - blockPos; //relative object position
-
-    // Point_t pt;
-    // void *fbuf = NULL;
-    // Point_t * pbuf = NULL;
-
-    // if(dbd->collectDataFlag){
-        // fbuf = (float *) buf;
-    // }else{
-        // pbuf = (Point_t *) buf;
-    // }
-
-
-    // extract object from block int Point_t structure
-    // which will be passed to buffer
-
-    float *fbuf, *fdata;
-    int * ibuf, *idata;
+    dbd->packObject(dbd->packLayout(), *global_id, buf);
+}
 
-    if(dbd->collectDataFlag){
+/**
+* @brief Unpack data from Zoltan to block
+* @detailed Extracts data into allocated newblock
+*/
 
-        fbuf = (float *) buf;
+void DBD::zolt_unpack_obj_fn( 
+                            void * data,       
+                            int num_gid_entries,  
+                            ZOLTAN_ID_PTR global_id,
+                            int size,
+                            char *buf,
+                            int *ierr
+                            )
 
-         for(unsigned i = 0; i < dbd->objectSize.y;i++){
-        // for(unsigned j = 0 ; j < dbd->objectSize.x;j++){
+{
 
-            unsigned di = halo(rel.x, rel.y + i, esize.x );
-            //((rel.y + i + HALO_SIZE)*esize.x) + (rel.x + j + HALO_SIZE);
-            unsigned bi = i* dbd->objectSize.x ;
+    unused(size);
 
-            std::memcpy(&(fbuf[bi]),
-                       &(dbd->bdata.newTemp[di]), 
-                       dbd->objectSize.x*sizeof(float));
-        }
+    if(num_gid_entries != 1){
+        *ierr  = ZLT_ID_TOO_LONG;
+        return;
+    }
 
+    DynamicBlockDescriptor *dbd = (DynamicBlockDescriptor *) data;
 
-    }else{
+    if(dbd->callbackDbg) cout << "rank "  << dbd->getRank() << " unpack: " << *global_id << endl;
 
-        unsigned size;
-        unsigned offset;
-
-        for(int x = 0; x < 3;x++){
-            if(x == 0){
-                fdata = dbd->oldArray ? dbd->bdata.oldTemp : dbd->bdata.newTemp;
-                fbuf = reinterpret_cast<float *>(buf);
-                size = sizeof(float);
-                offset = 0;
-
-            }else if(x == 1){
-                offset = dbd->objectSize.x * dbd->objectSize.y;
-                fdata = dbd->bdata.domParams;
-                fbuf =  reinterpret_cast<float *>(buf);
-                fbuf += offset;
-                size = sizeof(float);
-
-            }else if(x == 2){
-
-                offset =  2*dbd->objectSize.x * dbd->objectSize.y;
-                idata = dbd->bdata.domMap;
-                fbuf = reinterpret_cast<float *>(buf); //second array offset
-                fbuf += offset;
-                ibuf = reinterpret_cast<int*>(fbuf);
-                size = sizeof(int);
-            }
+    dbd->unpackObject(dbd->unpackLayout(), *global_id, buf);
+}
 
+/**
+*   @brief Returns sizes of objects in bytes, all objects have the same size
+*/
+void DBD::zolt_obj_size_multi_fn(void * data,
+    int num_gid_entries,
+    int num_lid_entries,
+    int num_ids,
+    ZOLTAN_ID_PTR global_ids,
+    ZOLTAN_ID_PTR local_ids,
+    int *sizes,
+    int *ierr
+   )
+{
+    if(num_ids > 0)
+        sizes[0] = zolt_obj_size_fn(data, num_gid_entries, num_lid_entries, global_ids, local_ids, ierr);
 
-             for(unsigned i = 0; i < dbd->objectSize.y;i++){
-            // for(unsigned j = 0 ; j < dbd->objectSize.x;j++){
-    
-                unsigned di = halo(rel.x, rel.y + i, esize.x );
-                //((rel.y + i + HALO_SIZE)*esize.x) + (rel.x + j + HALO_SIZE);
-                unsigned bi = i* dbd->objectSize.x ;
+    for(int i = 1; i < num_ids; i++)
+        sizes[i] = sizes[0];
+}
 
-                // if( (unsigned char *) &(ibuf[bi]) > ((unsigned char *) buf) + memsize || 
-                    // (unsigned char *) &(fbuf[bi]) > ((unsigned char *) buf) + memsize){
-                    // throw runtime_error("pack_obj memory hazard");
-                // }
+/**
+ * @brief Extracts all exported objects in single pass
+ * @detailed Block layout is resolved once per call, objects are
+ *           packed by threads to offsets given by Zoltan.
+ */
 
-                if(x == 2){
+void DBD::zolt_pack_obj_multi_fn( void * data,
+    int num_gid_entries,
+    int num_lid_entries,
+    int num_ids,
+    ZOLTAN_ID_PTR global_ids,
+    ZOLTAN_ID_PTR local_ids,
+    int *dest,
+    int *sizes,
+    int *idx,
+    char * buf,
+    int *ierr
+    )
+{
 
-                     std::memcpy( &(ibuf[bi]),
-                                  &(idata[di]),
-                                  dbd->objectSize.x*size
-                                );
+    unused(local_ids);
+    unused(dest);
+    unused(sizes);
 
-                }else{
-                     std::memcpy(&(fbuf[bi]),
-                                 &(fdata[di]),
-                                 dbd->objectSize.x*size
-                                );
+    if(num_gid_entries != 1 || num_lid_entries != 1){
+        *ierr  = ZLT_ID_TOO_LONG;
+        return;
+    }
 
-                }
-    
-            }
+    DynamicBlockDescriptor * dbd = (DynamicBlockDescriptor *) data;
 
-        }
+    const ObjLayout l = dbd->packLayout();
 
+    // sources are only read, each object has its own part of buffer
+    #pragma omp parallel for schedule(static)
+    for(int i = 0; i < num_ids; i++){
+        dbd->packObject(l, global_ids[i], buf + idx[i]);
     }
 }
 
 /**
-* @brief Unpack data from Zoltan to block
-* @detailed Extracts data into allocated newblock
+* @brief Unpacks all imported objects in single pass
+* @detailed Halo frames of adjacent objects overlap, objects are written in order.
 */
 
-void DBD::zolt_unpack_obj_fn( 
+void DBD::zolt_unpack_obj_multi_fn( 
                             void * data,       
                             int num_gid_entries,  
-                            ZOLTAN_ID_PTR global_id,
-                            int size,
+                            int num_ids,
+                            ZOLTAN_ID_PTR global_ids,
+                            int *sizes,
+                            int *idx,
                             char *buf,
                             int *ierr
                             )
 
 {
 
-    unused(size);
+    unused(sizes);
 
     if(num_gid_entries != 1){
         *ierr  = ZLT_ID_TOO_LONG;
@@ -1540,134 +2171,131 @@ void DBD::zolt_unpack_obj_fn(
     }
 
     DynamicBlockDescriptor *dbd = (DynamicBlockDescriptor *) data;
-    unsigned gid = * global_id;
-
-    // if(rank == 12 ||  rank == 13 || rank == 14 ||  rank == 15 )
-        // cout << rank << ": " << gid << endl;
 
-    // if(gid >= dbd->totalObjsCnt){
-        // cout << dbd->rank << ": " << gid << endl;
-        // return;
-    // }
+    const ObjLayout l = dbd->unpackLayout();
 
-   // unsigned objarea = dbd->objectSize.x * dbd->objectSize.y; 
-    // unsigned memsize = 2*(objarea * sizeof(float)) + (objarea * sizeof(int));
+    for(int i = 0; i < num_ids; i++){
+        dbd->unpackObject(l, global_ids[i], buf + idx[i]);
+    }
+}
 
 
-    if(dbd->callbackDbg) cout << "rank "  << dbd->getRank() << " unpack: " << *global_id << endl;
+DBD::ObjLayout DBD::packLayout(void)
+{
+    ObjLayout l;
 
-    // Dims blockPos = dbd->tdesc.tile().getPosition();
-    Dims objPos = dbd->getCoordsByGID(gid);
-    
-    Dims blockPos, esize;
+    l.pos = tdesc.tile().getPosition();
+    l.esize = getExtSize();
+    l.halo = haloSize;
+    l.frame = getFrameSize();
 
+    // collected result is the last computed temperature
+    l.temp = collectDataFlag || !oldArray ? bdata.newTemp : bdata.oldTemp;
+    l.params = bdata.domParams;
+    l.map = bdata.domMap;
 
-    float * fdata, *fbuf;
-    fdata = fbuf = NULL;
-    int * idata, * ibuf;
-    idata = ibuf = NULL;
+    return l;
+}
 
-    // collecting data to write
-    if(dbd->collectDataFlag){
 
-        blockPos = Dims(0,0);
-        esize = Dims(dbd->edgeSize, dbd->edgeSize);
+DBD::ObjLayout DBD::unpackLayout(void)
+{
+    ObjLayout l;
 
-        Dims rel = objPos - blockPos; //relative object position
+    l.frame = getFrameSize();
 
+    // collecting data to write, target array without halo zone
+    if(collectDataFlag){
 
-        unsigned size = sizeof(float);
-        fbuf = (float *) buf;
+        if(rank != 0) throw runtime_error("unpack: possible segfault");
 
-        for(unsigned i = 0; i < dbd->objectSize.y;i++){
-        // for(unsigned j = 0 ; j < dbd->objectSize.x;j++){
+        l.pos = Dims(0,0);
+        l.esize = Dims(edgeSize, edgeSize);
+        l.halo = 0;
+        l.temp = resArray;
+        l.params = NULL;
+        l.map = NULL;
 
-            // offset in object (source) buffer
-            unsigned bi = i* dbd->objectSize.x; 
-            unsigned di = (rel.y + i) * esize.x + (rel.x); 
+    // unpacking to arbitraty block during domain mapping
+    }else{
 
-            //copy object data from buffer to block eg. unpack
-            if(dbd->rank != 0) throw runtime_error("unpack: possible segfault");
-            // target array withou halo zone
-            std::memcpy( &(dbd->resArray[di]), 
-                         &(fbuf[bi]),
-                        dbd->objectSize.x * size
-                        );
-            // dbd->resArray[di] = fbuf[bi];
+        l.pos = newBlock.tile.getPosition();
+        l.esize = newBlock.tile.getExtSize(haloSize);
+        l.halo = haloSize;
+        l.temp = newBlock.temp;
+        l.params = newBlock.params;
+        l.map = newBlock.map;
+    }
 
-        }
+    return l;
+}
 
-    }else{
 
-        // unpacking to arbitraty block during domain mapping
-        blockPos = dbd->newBlock.tile.getPosition();
-        esize = dbd->newBlock.tile.getExtSize();
+void DBD::packObject(const ObjLayout & l, unsigned gid, char * buf)
+{
+    Dims rel = getCoordsByGID(gid) - l.pos; //relative object position
 
-        Dims rel = objPos - blockPos; //relative object position
+    // temperature of object is followed by static fields (params, map)
+    // of object extended by halo frame, receiver gets its halo zones
+    // of static fields with objects, frame never exceeds extended block
+    float * fbuf = reinterpret_cast<float *>(buf);
 
+    for(unsigned i = 0; i < objectSize.y;i++){
 
-        unsigned size;
-        unsigned offset;
+        unsigned di = halo(rel.x, rel.y + i, l.esize.x, l.halo);
+        unsigned bi = i* objectSize.x;
 
+        std::memcpy(&(fbuf[bi]), &(l.temp[di]), objectSize.x*sizeof(float));
+    }
 
-        for(int x = 0; x < 3;x++){
+    // collected result has temperature only
+    if(collectDataFlag)
+        return;
 
-            if(x == 0){
-                offset = 0;
-                fdata =  dbd->newBlock.temp;
-                fbuf = reinterpret_cast<float *>(buf);
-                size = sizeof(float);
-            }else if(x == 1){
+    fbuf += objectSize.x * objectSize.y;
+    int * ibuf = reinterpret_cast<int *>(fbuf + l.frame.x * l.frame.y);
 
-                offset = dbd->objectSize.x * dbd->objectSize.y ;
-                fdata =  dbd->newBlock.params;
-                // fbuf = (float *) (buf + offset);
-                fbuf = reinterpret_cast<float*>(buf);
-                fbuf += offset;
-                size = sizeof(float);
+    for(unsigned i = 0; i < l.frame.y;i++){
 
-            }else if(x == 2){
-                offset = 2*dbd->objectSize.x * dbd->objectSize.y;
-                idata = dbd->newBlock.map;
-                fbuf = reinterpret_cast<float*>(buf);
-                fbuf += offset;
-                ibuf = reinterpret_cast<int*>(fbuf);
-                size = sizeof(int);
-            }
+        // frame starts at halo(rel.x - haloSize, rel.y - haloSize)
+        unsigned di = (rel.y + i) * l.esize.x + rel.x;
+        unsigned bi = i * l.frame.x;
 
+        std::memcpy(&(fbuf[bi]), &(l.params[di]), l.frame.x*sizeof(float));
+        std::memcpy(&(ibuf[bi]), &(l.map[di]), l.frame.x*sizeof(int));
+    }
+}
 
-             for(unsigned i = 0; i < dbd->objectSize.y;i++){
-            // for(unsigned j = 0 ; j < dbd->objectSize.x;j++){
-    
-                unsigned di = halo(rel.x, rel.y + i, esize.x );
-                //((rel.y + i + HALO_SIZE)*esize.x) + (rel.x + j + HALO_SIZE);
-                unsigned bi = i* dbd->objectSize.x ;
-
-               // if( (unsigned char *) &(ibuf[bi]) > ((unsigned char *) buf) + memsize || 
-                    // (unsigned char *) &(fbuf[bi]) > ((unsigned char *) buf) + memsize){
-                    // throw runtime_error("pack_obj memory hazard");
-                // }
-    
-                if(x == 2){
-                    std::memcpy(  &(idata[di]), 
-                                  &(ibuf[bi]) ,
-                                  dbd->objectSize.x*size
-                                );
 
-                }else{
+void DBD::unpackObject(const ObjLayout & l, unsigned gid, char * buf)
+{
+    Dims rel = getCoordsByGID(gid) - l.pos; //relative object position
 
-                     std::memcpy(  &(fdata[di]), 
-                                  &(fbuf[ bi]) ,
-                                  dbd->objectSize.x*size
-                                );
+    // layout see packObject
+    float * fbuf = reinterpret_cast<float *>(buf);
 
+    for(unsigned i = 0; i < objectSize.y;i++){
 
-                }
-            }
+        unsigned di = halo(rel.x, rel.y + i, l.esize.x, l.halo);
+        unsigned bi = i* objectSize.x;
 
-        }
+        std::memcpy(&(l.temp[di]), &(fbuf[bi]), objectSize.x*sizeof(float));
     }
 
+    if(collectDataFlag)
+        return;
+
+    fbuf += objectSize.x * objectSize.y;
+    int * ibuf = reinterpret_cast<int *>(fbuf + l.frame.x * l.frame.y);
+
+    for(unsigned i = 0; i < l.frame.y;i++){
+
+        unsigned di = (rel.y + i) * l.esize.x + rel.x;
+        unsigned bi = i * l.frame.x;
+
+        std::memcpy(&(l.params[di]), &(fbuf[bi]), l.frame.x*sizeof(float));
+        std::memcpy(&(l.map[di]), &(ibuf[bi]), l.frame.x*sizeof(int));
+    }
 }
 
 /**
@@ -1756,9 +2384,6 @@ void DBD::zolt_obj_list_fn(     void *data,
 
     unused(num_gid);
     unused(num_lid);
-    unused(local_ids);
-    unused(wgt_dim);
-    unused(obj_wgts);
     unused(ierr);
 
     DynamicBlockDescriptor * dbd = (DynamicBlockDescriptor *) data;
@@ -1769,6 +2394,12 @@ void DBD::zolt_obj_list_fn(     void *data,
     for(auto obj : *ids){
 
         global_ids[idx] = obj;
+        local_ids[idx] = obj;
+
+        // see zoltanPartition
+        for(int w = 0; w < wgt_dim; w++)
+            obj_wgts[idx * wgt_dim + w] = idx < dbd->objWeights.size() ? dbd->objWeights[idx] : 1.0f;
+
         idx++;
     }
 
@@ -27,6 +27,7 @@
 #include <iostream>
 #include <vector>
 #include <list>
+#include <set>
 #include <utility>
 #include <iterator>
 
@@ -61,14 +62,22 @@ const int ZLT_UNSUP_DIMS = 2;
 
 const int HALO_SIZE = 2;
 
+// loads of row neighbors, STRATEGY_DIFFUSION
+const int TAG_DIFFUSION = 3;
+
+// rectangle migration (native and asynchronous), fields of tile intersections
+const int TAG_RECT_PARAMS = 4;
+const int TAG_RECT_MAP = 5;
+const int TAG_RECT_TEMP = 6;
+
 /**
 * @brief Maps given coordinates to array index respection halo zone size
 * 
 */ 
 
-inline unsigned halo(unsigned x, unsigned y, unsigned esize)
+inline unsigned halo(unsigned x, unsigned y, unsigned esize, unsigned haloSize = HALO_SIZE)
 {
-    return ((y + HALO_SIZE) * esize) + (x + HALO_SIZE);
+    return ((y + haloSize) * esize) + (x + haloSize);
 }
               // CheckRank method relies on it
 
@@ -114,8 +123,23 @@ public:
      * @param edgeSize [in] size of 2D domain matrix edge 
      * @param rank [in] current process MPI rank
      * @param worldSize [in] size of MPI world
-     */
-    DynamicBlockDescriptor( int rank, int worldSize, size_t edgeSize, Dims objSize, double threshold);
+     * @param haloSize [in] width of halo zones, 2 * steps computed per exchange
+     * @param exchange [in] halo exchange backend (TExchange)
+     * @param strategy [in] repartitioning strategy (TStrategy)
+     * @param hysteresis [in] periods imbalance has to persist (LoadBalancer::decide)
+     * @param budget [in] objects moved by single migration step, 0 - unlimited
+     * @param asyncLag [in] iterations between decision and cutover of asynchronous
+     *                 migration, 0 - migration within loadBalance
+     * @param native [in] migration moves tile intersections by subarray datatypes,
+     *               false - objects are migrated by Zoltan callbacks
+     * @param nodeAware [in] work moves between nodes only if node loads are imbalanced
+     * @param placement [in] nodes get compact blocks of regular mesh instead of rows
+     */
+    DynamicBlockDescriptor( int rank, int worldSize, size_t edgeSize, Dims objSize, double threshold,
+                            unsigned haloSize = HALO_SIZE, int exchange = EXCHANGE_SCATTER,
+                            int strategy = STRATEGY_WIDTHS, unsigned hysteresis = 1, unsigned budget = 0,
+                            unsigned asyncLag = 0, bool native = false, bool nodeAware = false,
+                            bool placement = false);
 
     ~DynamicBlockDescriptor(void);
 
@@ -146,13 +170,119 @@ public:
      * Upon true returned, balancing performed, BlockData will be updated
      * Re-initialization of neighbor comms is necessary.
      * 
+     * New partition is skipped, if its predicted saving over remaining
+     * iterations does not exceed migration cost estimated from moved bytes
+     * and history of migrations (see recordMigration).
+     *
      * @param pm - performance measurement object with data about last iterations
      * @param block - BlockData reference, will be update if load balance occurs
+     * @param remaining - iterations left, 0 disables cost-benefit gate
      * @return true if balancing performed
      * 
      */
 
-    bool loadBalance(PerfMeasure & pm, BlockData & block);
+    bool loadBalance(PerfMeasure & pm, BlockData & block, unsigned remaining = 0);
+
+    /**
+     * @brief Diffusion step of STRATEGY_DIFFUSION, called by loadBalance
+     *
+     * @details Loads are exchanged with left and right neighbor in row only,
+     *          edge is moved by its left tile (LoadBalancer::edgeShift), so
+     *          both sides agree without negotiation. Row loads are reduced
+     *          within row and exchanged with rows above and below, bottom
+     *          edge of row is moved by the row, so row heights diffuse too.
+     *          Shifts are published by allgather of two ints over all ranks,
+     *          tile table and Zoltan migration are global in this
+     *          implementation, so the step still synchronizes globally.
+     *
+     * @return true if any edge moved
+     */
+    bool diffuse(PerfMeasure & pm, BlockData & block);
+
+    /**
+     * @brief True if incremental migration has not reached its target
+     */
+    bool migrationPending(void) const   { return !pendingTiles.empty(); }
+
+    /**
+     * @brief Moves at most budget objects towards pending target layout
+     *
+     * @details Must be called only when halo zones are valid, topology
+     *          changes as after loadBalance. Large repartition of row
+     *          layouts is split to several steps by loadBalance.
+     *
+     * @return true if topology changed
+     */
+    bool migrateStep(BlockData & block);
+
+    /**
+     * @brief True if asynchronous migration was started and not cut over
+     */
+    bool asyncPending(void) const       { return !asyncTiles.empty(); }
+
+    /**
+     * @brief True if asynchronous migration should be cut over now
+     * @details All ranks count the same iterations, so they agree without communication.
+     */
+    bool asyncDue(void) const           { return asyncPending() && asyncLeft == 0; }
+
+    /**
+     * @brief Drives transfer of static fields, called once per iteration
+     */
+    void asyncProgress(void);
+
+    /**
+     * @brief Finishes asynchronous migration
+     *
+     * @details Waits for static fields of new tile, transfers temperature
+     *          of new tile and switches to new topology. Must be called
+     *          only when halo zones are valid, as migrateStep.
+     *
+     * @return true if topology changed
+     */
+    bool asyncCutover(BlockData & block);
+
+    /**
+     * @brief Drops asynchronous migration that was not cut over
+     *
+     * @details Waits for transfers of static fields already posted (peers
+     *          posted matching requests) and frees pending tile. Topology
+     *          does not change. Must be called by all ranks before data
+     *          are collected, the decision is global.
+     */
+    void asyncCancel(void);
+
+    /**
+     * @brief Stores duration of last migration for cost-benefit gate
+     * @param time - whole balancing step, including halo exchange re-planning
+     */
+    void recordMigration(double time)   { migTimeTotal += time; migBytesTotal += lastMigBytes; }
+
+    /**
+     * @brief Bytes of single migrated object, see zolt_obj_size_fn
+     */
+    unsigned getObjBytes(void) const;
+
+    /**
+     * @brief Computes new decomposition by Zoltan geometric partitioner
+     * @details Collective, called by all ranks. Objects are weighted
+     *          by measured time of owning rank. Parts are gathered
+     *          as bounding boxes of assigned objects.
+     *
+     * @param time - measured time of this rank
+     * @return new tiles ordered by rank, NULL if any part is not rectangle
+     */
+    vector<TileDescriptor> * zoltanPartition(double time);
+
+    /**
+     * @brief Buffer for sampled compute cost of assigned objects
+     * @details Objects are ordered as getAssignGIDs(), row by row in tile.
+     *          Costs are consumed by next loadBalance(), objects
+     *          of equal cost are assumed if not sampled by all ranks.
+     *
+     * @return array of objects count of actual tile
+     */
+    float * getObjCosts(void);
 
     /**
      * @brief   Compares old and new decomposition and setes appropriate
@@ -239,6 +369,20 @@ public:
     // compute and return middle column temp
     float middleColAvg(void);
 
+    /**
+     * @brief Builds stencil weights for current block
+     *
+     * @details Must be called after halo zones of domParams and domMap
+     *          are filled, eg. after initial halo exchange and after each
+     *          loadBalance() call returning true. Weights memory is reused
+     *          while block size does not change.
+     *
+     * @param block - BlockData, weights pointer is updated
+     * @param airFlowRate - air flow rate
+     * @param coolerTemp - cooler temperature
+     */
+    void updateWeights(BlockData & block, float airFlowRate, float coolerTemp);
+
     /**
      * @brief Calculates MPI ranks, which belong to neighbor blocks.
      * @return vector reference
@@ -297,7 +441,7 @@ public:
      * @return [description]
      */
 
-    unsigned getExtArea(void)                { return tdesc.tile().getExtArea(); }
+    unsigned getExtArea(void)                { return tdesc.tile().getExtArea(haloSize); }
     /**
      * @brief Returns area fo whole computational domain
      */
@@ -316,8 +460,24 @@ public:
 
     int getRank(const Dims & blockPosition);
 
+    /**
+     * @brief Returns length of halo buffer (send and receive)
+     */
     unsigned getHaloLen(void);
 
+    /**
+     * @brief Returns width of halo zones
+     */
+    unsigned getHaloSize(void) const    { return haloSize; }
+    Dims getObjectSize(void) const      { return objectSize; }
+
+    /**
+     * @brief Returns size of object extended by halo frame
+     * @details Static fields (params, map) migrate with halo frame,
+     *          their halo zones need not be exchanged after migration.
+     */
+    Dims getFrameSize(void) const       { return objectSize + Dims(2*haloSize, 2*haloSize); }
+
     /**
      * @brief Returns dimensions of current block
      * @details Dims object
@@ -329,7 +489,7 @@ public:
      * @return Dims object
      */
 
-    Dims getExtSize()         { return tdesc.tile().getExtSize(); }
+    Dims getExtSize()         { return tdesc.tile().getExtSize(haloSize); }
     /**
      * @brief Position of current block in range <0, blocks_in_row>, <0, blocks_in_col>
      * @return [description]
@@ -348,6 +508,15 @@ public:
      */
     BlockData    getBlockData(void);
 
+    /**
+     * @brief Switches halo exchange backend of actual topology
+     * @details Communicators of the backend are created by
+     *          TopologyDescriptor::updateTopology, collective.
+     * @param exchange - halo exchange backend (TExchange)
+     * @return BlockData of actual topology
+     */
+    BlockData    setExchange(int exchange);
+
     void initBlockData(const TMaterialProperties & data);
     
     /**
@@ -368,9 +537,15 @@ protected:
 
     // balancing counter
     unsigned balanceSeq;
+
+    // ranks of row of tiles, STRATEGY_DIFFUSION, created by first diffuse
+    MPI_Comm rowComm;
     
     size_t edgeSize;
 
+    // width of halo zones
+    unsigned haloSize;
+
     bool datatypesInitialized;
 
 
@@ -386,6 +561,10 @@ protected:
     // temporary data for data migration purpose
     TempBlock newBlock;
 
+    // stencil weights storage and its size in floats
+    float * weights;
+    unsigned weightsSize;
+
 
     // zoltan object size
     Dims objectSize;
@@ -398,6 +577,87 @@ protected:
     // total - all object in the model domain
     unsigned assignedObjsCnt, totalObjsCnt;
 
+    // sampled compute cost of assigned objects, empty if not sampled
+    vector<float> objCosts;
+
+    // weights of assigned objects for Zoltan partitioners
+    vector<float> objWeights;
+
+    // nodes get compact blocks of regular mesh, see LoadBalancer::setHosts
+    bool placement;
+
+    // incremental migration, objects per step (0 - unlimited) and target layout
+    unsigned migrationBudget;
+    vector<TileDescriptor> pendingTiles;
+
+    /**
+     * @brief Migrates data to new layout and updates topology
+     */
+    void applyTiles(const vector<TileDescriptor> & tls, BlockData & block);
+
+    // rectangle migration, requests and subarray types of transfers in flight
+    bool nativeMigration;
+    vector<MPI_Request> rectRequests;
+    vector<MPI_Datatype> rectTypes;
+
+    /**
+     * @brief Moves all fields to new layout by rectangle transfers
+     * @details Replaces Zoltan Migrate, one message per field and pair of
+     *          old and new owner, received directly into newBlock.
+     */
+    void migrateRects(const vector<TileDescriptor> & tls);
+
+    /**
+     * @brief Completes posted rectangle transfers
+     */
+    void waitRects(void);
+
+    // asynchronous migration, target layout, iterations to cutover
+    unsigned asyncLag;
+    unsigned asyncLeft;
+    vector<TileDescriptor> asyncTiles;
+
+    /**
+     * @brief Starts background transfer of static fields to new layout
+     * @details Old topology keeps computing, newBlock holds the pending tile.
+     */
+    void asyncStart(const vector<TileDescriptor> & tls);
+
+    /**
+     * @brief Posts point to point transfers of rectangles between layouts
+     *
+     * @details Rank receives part of its new tile (extended by grow) held
+     *          by every old tile and sends part of its old tile needed by
+     *          every new tile.
+     *
+     * @param grow - haloSize for static fields, 0 for temperature
+     * @param temp - temperature (oldTemp to newBlock.temp) or params and map
+     */
+    void postRects(const vector<TileDescriptor> & tls, int grow, bool temp);
+
+    /**
+     * @brief Old arrays are freed, newBlock arrays become actual
+     */
+    void adoptNewBlock(void);
+
+    // cost-benefit gate, root only
+    // bytes moved by last migration, history of migrations
+    double lastMigBytes;
+    double migBytesTotal, migTimeTotal;
+
+    // bytes of objects moved while computation stalls, static fields
+    // of asynchronous migration move in background and are not counted
+    double stallBytes(unsigned objects) const;
+
+    /**
+     * @brief Collects sampled object costs to root
+     * @details Collective. Costs are placed to domain matrix of objects,
+     *          result is empty if any rank has not sampled its tile.
+     *
+     * @return cost of every object in domain (row-major) on root
+     */
+    vector<double> gatherCosts(void);
+
     
     /**
      *  @details Collecting data from all processes to root.
@@ -574,6 +834,59 @@ protected:
                                   );
 
 
+    static void zolt_obj_size_multi_fn(void * data,
+                     int num_gid_entries,
+                     int num_lid_entries,
+                     int num_ids,
+                     ZOLTAN_ID_PTR global_ids,
+                     ZOLTAN_ID_PTR local_ids,
+                     int *sizes,
+                     int *ierr
+                     );
+
+    static void zolt_pack_obj_multi_fn( void * data,
+                            int num_gid_entries,
+                            int num_lid_entries,
+                            int num_ids,
+                            ZOLTAN_ID_PTR global_ids,
+                            ZOLTAN_ID_PTR local_ids,
+                            int *dest,
+                            int *sizes,
+                            int *idx,
+                            char * buf,
+                            int *ierr
+                            );
+
+    static void zolt_unpack_obj_multi_fn( void * data,
+                                  int num_gid_entries,
+                                  int num_ids,
+                                  ZOLTAN_ID_PTR global_ids,
+                                  int *sizes,
+                                  int *idx,
+                                  char *buf,
+                                  int *ierr
+                                  );
+
+    // block accessed by pack and unpack, resolved once per callback
+    struct ObjLayout {
+        Dims pos;       // tile position
+        Dims esize;     // size of array including halo zones
+        unsigned halo;  // halo width of array
+        Dims frame;     // object extended by halo frame
+        float * temp;
+        float * params;
+        int * map;
+    };
+
+    ObjLayout packLayout(void);
+    ObjLayout unpackLayout(void);
+
+    /**
+     * @brief Copies single object between block and Zoltan buffer
+     */
+    void packObject(const ObjLayout & l, unsigned gid, char * buf);
+    void unpackObject(const ObjLayout & l, unsigned gid, char * buf);
+
     static void zolt_obj_list_fn( void *data,
                                 int num_gid,
                                 int num_lid, 
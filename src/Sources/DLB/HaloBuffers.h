@@ -27,67 +27,42 @@ public:
 
 	HaloBuffers(void):
 	sendTemp(NULL),
-	sendParams(NULL),
-	sendMap(NULL),
-	recvTemp(NULL),
-	recvParams(NULL),
-	recvMap(NULL)
+	recvTemp(NULL)
 	{}
 
 	HaloBuffers(unsigned size)
 	{
 		sendTemp = new float[size];
-		sendParams = new float[size];
-		sendMap = new int[size];
-
 		recvTemp = new float[size];
-		recvParams = new float[size];
-		recvMap = new int[size];
 	}
 
 	~HaloBuffers(void)
 	{
 		delete[] sendTemp;
-		delete[] sendParams;
-		delete[] sendMap;
-
 		delete[] recvTemp;
-		delete[] recvParams;
-		delete[] recvMap;
 	}
 
 	void resize(unsigned newSize)
 	{
 
 		delete[] sendTemp;
-		delete[] sendParams;
-		delete[] sendMap;
-
 		delete[] recvTemp;
-		delete[] recvParams;
-		delete[] recvMap;
 
 		sendTemp = new float[newSize];
-		sendParams = new float[newSize];
-		sendMap = new int[newSize];
-
 		recvTemp = new float[newSize];
-		recvParams = new float[newSize];
-		recvMap = new int[newSize];
 		
 	}
 
 
 
+	// only temperature is exchanged, static fields
+	// migrate with halo frames (DBD::getFrameSize)
+
 	//send
 	float * sendTemp;
-	float * sendParams;
-	int * sendMap;
 
 	//receive
 	float * recvTemp;
-	float * recvParams;
-	int * recvMap;
 
 
 
@@ -0,0 +1,697 @@
+/***********************************************
+*
+*  File Name:       HaloExchanger.cpp
+*
+*  Project:         Dynamic Load Balancing in HPC Applications
+*                   DIP (SC@FIT)
+*
+*  Description:     Halo zone exchange implementation
+*
+*******************************************/
+
+#include "HaloExchanger.h"
+
+using HaloExchanger = DLB::HaloExchanger;
+using BlockData = DLB::BlockData;
+using HaloBuffers = DLB::HaloBuffers;
+using Dims = DLB::Dims;
+using ScatterExchanger = DLB::ScatterExchanger;
+using NeighborExchanger = DLB::NeighborExchanger;
+using PersistentExchanger = DLB::PersistentExchanger;
+using DatatypeExchanger = DLB::DatatypeExchanger;
+using SharedExchanger = DLB::SharedExchanger;
+using RmaExchanger = DLB::RmaExchanger;
+
+
+HaloExchanger * HaloExchanger::create(int exchange, int progress)
+{
+    switch(exchange){
+
+        case EXCHANGE_SCATTER:    return new ScatterExchanger(progress);
+        case EXCHANGE_NEIGHBOR:   return new NeighborExchanger(progress);
+        case EXCHANGE_PERSISTENT: return new PersistentExchanger(progress);
+        case EXCHANGE_DATATYPE:   return new DatatypeExchanger(progress);
+        case EXCHANGE_SHARED:     return new SharedExchanger(progress);
+        case EXCHANGE_RMA:        return new RmaExchanger(progress);
+    }
+
+    throw runtime_error("HaloExchanger: unknown exchange backend " + std::to_string(exchange));
+}
+
+
+HaloExchanger::HaloExchanger(int exchange, int progress):
+exchange(exchange),
+hb(NULL),
+active(&requests[0]),
+persistent(false),
+progress(progress),
+completed(true),
+progressPending(false),
+progressStop(false),
+sendBytes(0),
+exchanges(0),
+bytes(0),
+time(0),
+startTime(0)
+{
+    MPI_assert( MPI_Comm_dup(MPI_COMM_WORLD, &comm), "Comm dup failed" LOCATION);
+
+    if(progress == PROGRESS_THREAD)
+        progressThread = std::thread(&HaloExchanger::progressLoop, this);
+}
+
+HaloExchanger::~HaloExchanger(void)
+{
+    if(progressThread.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(progressLock);
+            progressStop = true;
+        }
+        progressCv.notify_all();
+        progressThread.join();
+    }
+
+    freeRequests();
+
+    MPI_assert( MPI_Comm_free(&comm) LOCATION);
+}
+
+void HaloExchanger::freeRequests(void)
+{
+    for(auto & s : requests){
+
+        if(persistent){
+            for(auto & r : s){
+                if(r != MPI_REQUEST_NULL)
+                    MPI_assert( MPI_Request_free(&r), "Request free failed" LOCATION);
+            }
+        }
+
+        s.clear();
+    }
+
+    active = &requests[0];
+    persistent = false;
+}
+
+
+void HaloExchanger::release(void)
+{
+    freeRequests();
+}
+
+
+void HaloExchanger::resetCounters(void)
+{
+    exchanges = 0;
+    bytes = 0;
+    time = 0;
+}
+
+
+void HaloExchanger::plan(const BlockData & bd, HaloBuffers & hb, Dims ext)
+{
+    freeRequests();
+
+    this->bd = bd;
+    this->hb = &hb;
+    this->ext = ext;
+
+    sendBytes = 0;
+
+    for(auto n : *bd.neighbors)
+        sendBytes += bd.nData->at(n).sendCount * sizeof(float);
+
+    planBackend();
+
+    statuses.resize(std::max(requests[0].size(), requests[1].size()));
+}
+
+
+void HaloExchanger::start(float * block)
+{
+    startTime = MPI_Wtime();
+
+    post(block);
+
+    completed = false;
+
+    if(progress == PROGRESS_THREAD){
+        {
+            std::lock_guard<std::mutex> lock(progressLock);
+            progressPending = true;
+        }
+        progressCv.notify_all();
+    }
+}
+
+
+void HaloExchanger::wait(float * block)
+{
+    if(progress == PROGRESS_THREAD){
+
+        // helper thread owns requests until exchange completes
+        std::unique_lock<std::mutex> lock(progressLock);
+        progressCv.wait(lock, [this]{ return !progressPending; });
+    }
+
+    completed = true;
+
+    // requests completed by test() or helper thread are inactive/null
+    if(!active->empty())
+        MPI_assert( MPI_Waitall(active->size(), active->data(), statuses.data()), "Waitall failed" LOCATION);
+
+    finish(block);
+
+    exchanges++;
+    bytes += sendBytes;
+    time += MPI_Wtime() - startTime;
+}
+
+
+void HaloExchanger::test(void)
+{
+    if(progress != PROGRESS_POLL || completed)
+        return;
+
+    int flag = 0;
+
+    MPI_assert( MPI_Testall(active->size(), active->data(), &flag, MPI_STATUSES_IGNORE), "Testall failed" LOCATION);
+
+    completed = flag;
+}
+
+
+void HaloExchanger::progressLoop(void)
+{
+    std::unique_lock<std::mutex> lock(progressLock);
+
+    while(true){
+
+        progressCv.wait(lock, [this]{ return progressPending || progressStop; });
+
+        if(progressStop)
+            return;
+
+        lock.unlock();
+
+        int flag = 0;
+
+        while(!flag){
+
+            MPI_assert( MPI_Testall(active->size(), active->data(), &flag, MPI_STATUSES_IGNORE), "Testall failed" LOCATION);
+
+            if(!flag)
+                std::this_thread::yield();
+        }
+
+        lock.lock();
+        progressPending = false;
+        progressCv.notify_all();
+    }
+}
+
+
+void HaloExchanger::exchangeInit(void)
+{
+    start(bd.oldTemp);
+    wait(bd.oldTemp);
+
+    // copy received halo zone to second temperature array
+    for(auto n : *bd.neighbors){
+
+        const Neighbor & nb = bd.nData->at(n);
+
+        for(unsigned i = 0; i < nb.recvSize.y; i++){
+
+            unsigned idx = (nb.recvPos.y + i) * ext.x + nb.recvPos.x;
+            std::memcpy(&(bd.newTemp[idx]), &(bd.oldTemp[idx]), nb.recvSize.x * sizeof(float));
+        }
+    }
+}
+
+
+/*
+ * EXCHANGE_SCATTER
+ */
+
+void ScatterExchanger::planBackend(void)
+{
+    cnts.assign(bd.counts->begin(), bd.counts->end());
+    displs.assign(bd.displs->begin(), bd.displs->end());
+
+    // Iscatterv posted in start(), root + one per neighbor
+    requests[0].resize(bd.neighbors->size() + 1, MPI_REQUEST_NULL);
+}
+
+
+void ScatterExchanger::post(float * block)
+{
+    HaloToBuff<float>(block, hb->sendTemp, bd, ext);
+
+    MPI_assert( MPI_Iscatterv(hb->sendTemp, cnts.data(), displs.data(), MPI_FLOAT, NULL, 0, MPI_FLOAT,
+                              bd.myCommRank, bd.myComm, &(requests[0][0])),
+                "Temp scatter send failed" LOCATION );
+
+    int idx = 1;
+    for(auto n : *bd.neighbors){
+
+        const Neighbor & nb = bd.nData->at(n);
+
+        MPI_assert( MPI_Iscatterv(NULL, nb.scatterCnts, nb.scatterDispls, MPI_FLOAT,
+                                  &(hb->recvTemp[nb.displ]), nb.count, MPI_FLOAT,
+                                  nb.root, nb.comm, &(requests[0][idx])),
+                    "Temp scatter receive failed" LOCATION );
+        idx++;
+    }
+}
+
+
+void ScatterExchanger::finish(float * block)
+{
+    BuffToHalo<float>(block, hb->recvTemp, bd, ext);
+}
+
+
+/*
+ * EXCHANGE_NEIGHBOR
+ */
+
+void NeighborExchanger::planBackend(void)
+{
+    requests[0].resize(1, MPI_REQUEST_NULL);
+
+#if MPI_VERSION >= 4
+    MPI_assert( MPI_Neighbor_alltoallv_init(hb->sendTemp, bd.nbrSendCounts->data(), bd.nbrSendDispls->data(), MPI_FLOAT,
+                                            hb->recvTemp, bd.nbrRecvCounts->data(), bd.nbrRecvDispls->data(), MPI_FLOAT,
+                                            bd.graphComm, MPI_INFO_NULL, &(requests[0][0])),
+                "Neighbor_alltoallv_init failed" LOCATION);
+    persistent = true;
+#endif
+}
+
+
+void NeighborExchanger::post(float * block)
+{
+    HaloToBuff<float>(block, hb->sendTemp, bd, ext);
+
+    if(persistent){
+
+        MPI_assert( MPI_Startall(requests[0].size(), requests[0].data()), "Startall failed" LOCATION);
+
+    }else{
+
+        MPI_assert( MPI_Ineighbor_alltoallv(hb->sendTemp, bd.nbrSendCounts->data(), bd.nbrSendDispls->data(), MPI_FLOAT,
+                                            hb->recvTemp, bd.nbrRecvCounts->data(), bd.nbrRecvDispls->data(), MPI_FLOAT,
+                                            bd.graphComm, &(requests[0][0])),
+                    "Temp neighbor exchange failed" LOCATION );
+    }
+}
+
+
+void NeighborExchanger::finish(float * block)
+{
+    BuffToHalo<float>(block, hb->recvTemp, bd, ext);
+}
+
+
+/*
+ * EXCHANGE_PERSISTENT
+ */
+
+void PersistentExchanger::planBackend(void)
+{
+    for(auto n : *bd.neighbors){
+
+        const Neighbor & nb = bd.nData->at(n);
+        MPI_Request r;
+
+        MPI_assert( MPI_Recv_init(hb->recvTemp + nb.displ, nb.count, MPI_FLOAT, n, TAG_TEMP, comm, &r),
+                    "Recv_init failed" LOCATION);
+        requests[0].push_back(r);
+
+        MPI_assert( MPI_Send_init(hb->sendTemp + nb.sendDispl, nb.sendCount, MPI_FLOAT, n, TAG_TEMP, comm, &r),
+                    "Send_init failed" LOCATION);
+        requests[0].push_back(r);
+    }
+
+    persistent = true;
+}
+
+
+void PersistentExchanger::post(float * block)
+{
+    HaloToBuff<float>(block, hb->sendTemp, bd, ext);
+
+    if(!requests[0].empty())
+        MPI_assert( MPI_Startall(requests[0].size(), requests[0].data()), "Startall failed" LOCATION);
+}
+
+
+void PersistentExchanger::finish(float * block)
+{
+    BuffToHalo<float>(block, hb->recvTemp, bd, ext);
+}
+
+
+/*
+ * EXCHANGE_DATATYPE
+ */
+
+void DatatypeExchanger::planBackend(void)
+{
+    typeBlocks[0] = bd.oldTemp;
+    typeBlocks[1] = bd.newTemp;
+
+    for(int i = 0; i < 2; i++){
+        for(auto n : *bd.neighbors){
+
+            const Neighbor & nb = bd.nData->at(n);
+            MPI_Request r;
+
+            MPI_assert( MPI_Recv_init(typeBlocks[i], 1, nb.recvType, n, TAG_TEMP, comm, &r),
+                        "Recv_init failed" LOCATION);
+            requests[i].push_back(r);
+
+            MPI_assert( MPI_Send_init(typeBlocks[i], 1, nb.sendType, n, TAG_TEMP, comm, &r),
+                        "Send_init failed" LOCATION);
+            requests[i].push_back(r);
+        }
+    }
+
+    persistent = true;
+}
+
+
+void DatatypeExchanger::post(float * block)
+{
+    // arrays are swapped every step, pick requests bound to this one
+    active = (block == typeBlocks[0]) ? &requests[0] : &requests[1];
+
+    if(!active->empty())
+        MPI_assert( MPI_Startall(active->size(), active->data()), "Startall failed" LOCATION);
+}
+
+
+void DatatypeExchanger::finish(float *)
+{
+    // halo zone received in place
+}
+
+
+/*
+ * EXCHANGE_SHARED
+ */
+
+SharedExchanger::SharedExchanger(int progress):
+HaloExchanger(EXCHANGE_SHARED, progress),
+nodeComm(MPI_COMM_NULL),
+shmWin(MPI_WIN_NULL),
+shmFlag(NULL),
+shmLen(0),
+epoch(0)
+{
+    shmSend[0] = shmSend[1] = NULL;
+
+    MPI_assert( MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm),
+                "Comm split type failed" LOCATION);
+}
+
+
+SharedExchanger::~SharedExchanger(void)
+{
+    // requests are bound to window
+    freeRequests();
+    freeShared();
+
+    MPI_assert( MPI_Comm_free(&nodeComm) LOCATION);
+}
+
+
+bool SharedExchanger::isShared(int n) const
+{
+    for(auto & p : shmPeers)
+        if(p.rank == n)
+            return true;
+
+    return false;
+}
+
+
+void SharedExchanger::freeShared(void)
+{
+    if(shmWin == MPI_WIN_NULL)
+        return;
+
+    MPI_assert( MPI_Win_unlock_all(shmWin), "Win unlock failed" LOCATION);
+    MPI_assert( MPI_Win_free(&shmWin), "Win free failed" LOCATION);
+
+    shmPeers.clear();
+    shmFlag = NULL;
+    shmSend[0] = shmSend[1] = NULL;
+}
+
+
+void SharedExchanger::planBackend(void)
+{
+    freeShared();
+
+    shmLen = 0;
+
+    for(auto n : *bd.neighbors){
+        const Neighbor & nb = bd.nData->at(n);
+        shmLen = std::max(shmLen, nb.sendDispl + nb.sendCount);
+    }
+
+    char * base;
+
+    MPI_assert( MPI_Win_allocate_shared(SHM_HEADER + 2 * shmLen * sizeof(float), 1, MPI_INFO_NULL,
+                                        nodeComm, &base, &shmWin),
+                "Win allocate shared failed" LOCATION);
+
+    shmFlag = reinterpret_cast<volatile long long *>(base);
+    *shmFlag = 0;
+    epoch = 0;
+
+    shmSend[0] = reinterpret_cast<float *>(base + SHM_HEADER);
+    shmSend[1] = shmSend[0] + shmLen;
+
+    // passive target epoch for whole topology, synchronized by MPI_Win_sync
+    MPI_assert( MPI_Win_lock_all(MPI_MODE_NOCHECK, shmWin), "Win lock failed" LOCATION);
+
+    MPI_Group worldGroup, nodeGroup;
+
+    MPI_assert( MPI_Comm_group(comm, &worldGroup) LOCATION);
+    MPI_assert( MPI_Comm_group(nodeComm, &nodeGroup) LOCATION);
+
+    // displacements of my rectangles in buffers of neighbors on the node
+    vector<unsigned> displ(bd.neighbors->size());
+    vector<MPI_Request> dreqs;
+
+    for(unsigned i = 0; i < bd.neighbors->size(); i++){
+
+        int n = bd.neighbors->at(i);
+        const Neighbor & nb = bd.nData->at(n);
+        int nodeRank;
+
+        MPI_assert( MPI_Group_translate_ranks(worldGroup, 1, &n, nodeGroup, &nodeRank) LOCATION);
+
+        if(nodeRank == MPI_UNDEFINED){
+
+            for(int p = 0; p < 2; p++){
+
+                MPI_Request r;
+
+                MPI_assert( MPI_Recv_init(hb->recvTemp + nb.displ, nb.count, MPI_FLOAT, n, TAG_TEMP, comm, &r),
+                            "Recv_init failed" LOCATION);
+                requests[p].push_back(r);
+
+                MPI_assert( MPI_Send_init(shmSend[p] + nb.sendDispl, nb.sendCount, MPI_FLOAT, n, TAG_TEMP, comm, &r),
+                            "Send_init failed" LOCATION);
+                requests[p].push_back(r);
+            }
+
+            continue;
+        }
+
+        MPI_Aint size;
+        int unit;
+        char * peer;
+
+        MPI_assert( MPI_Win_shared_query(shmWin, nodeRank, &size, &unit, &peer), "Win shared query failed" LOCATION);
+
+        ShmPeer sp;
+        sp.rank = n;
+        sp.flag = reinterpret_cast<volatile long long *>(peer);
+        sp.send[0] = reinterpret_cast<float *>(peer + SHM_HEADER);
+        sp.send[1] = sp.send[0] + (size - SHM_HEADER) / (2 * sizeof(float));
+        sp.displ = 0;
+        shmPeers.push_back(sp);
+
+        dreqs.push_back(MPI_REQUEST_NULL);
+        MPI_assert( MPI_Irecv(&(displ[i]), 1, MPI_UNSIGNED, n, TAG_DISPL, comm, &dreqs.back()), "Irecv failed" LOCATION);
+        dreqs.push_back(MPI_REQUEST_NULL);
+        MPI_assert( MPI_Isend(&(nb.sendDispl), 1, MPI_UNSIGNED, n, TAG_DISPL, comm, &dreqs.back()), "Isend failed" LOCATION);
+    }
+
+    MPI_assert( MPI_Waitall(dreqs.size(), dreqs.data(), MPI_STATUSES_IGNORE), "Waitall failed" LOCATION);
+
+    for(auto & sp : shmPeers){
+        unsigned i = std::find(bd.neighbors->begin(), bd.neighbors->end(), sp.rank) - bd.neighbors->begin();
+        sp.displ = displ[i];
+    }
+
+    MPI_Group_free(&worldGroup);
+    MPI_Group_free(&nodeGroup);
+
+    persistent = true;
+
+    // flags are zero before any neighbor reads them
+    MPI_assert( MPI_Win_sync(shmWin), "Win sync failed" LOCATION);
+    MPI_assert( MPI_Barrier(nodeComm), "Barrier failed" LOCATION);
+}
+
+
+void SharedExchanger::post(float * block)
+{
+    epoch++;
+
+    // buffer of previous epoch may still be read by neighbors
+    float * send = shmSend[epoch % 2];
+    active = &requests[epoch % 2];
+
+    HaloToBuff<float>(block, send, bd, ext);
+
+    if(!active->empty())
+        MPI_assert( MPI_Startall(active->size(), active->data()), "Startall failed" LOCATION);
+
+    // halo zone is visible before the flag
+    MPI_assert( MPI_Win_sync(shmWin), "Win sync failed" LOCATION);
+    *shmFlag = epoch;
+    MPI_assert( MPI_Win_sync(shmWin), "Win sync failed" LOCATION);
+}
+
+
+void SharedExchanger::finish(float * block)
+{
+    // neighbors on other nodes
+    for(auto n : *bd.neighbors){
+
+        if(isShared(n))
+            continue;
+
+        const Neighbor & nb = bd.nData->at(n);
+        float * src = hb->recvTemp + nb.displ;
+
+        for(unsigned i = 0; i < nb.recvSize.y; i++){
+
+            std::memcpy(&(block[(nb.recvPos.y + i) * ext.x + nb.recvPos.x]), src, nb.recvSize.x * sizeof(float));
+            src += nb.recvSize.x;
+        }
+    }
+
+    // neighbors on the node, rectangle is read from window when owner publishes epoch
+    for(auto & p : shmPeers){
+
+        while(*p.flag < epoch)
+            MPI_assert( MPI_Win_sync(shmWin), "Win sync failed" LOCATION);
+
+        MPI_assert( MPI_Win_sync(shmWin), "Win sync failed" LOCATION);
+
+        const Neighbor & nb = bd.nData->at(p.rank);
+        const float * src = p.send[epoch % 2] + p.displ;
+
+        for(unsigned i = 0; i < nb.recvSize.y; i++){
+
+            std::memcpy(&(block[(nb.recvPos.y + i) * ext.x + nb.recvPos.x]), src, nb.recvSize.x * sizeof(float));
+            src += nb.recvSize.x;
+        }
+    }
+}
+
+
+/*
+ * EXCHANGE_RMA
+ */
+
+RmaExchanger::RmaExchanger(int progress):
+HaloExchanger(EXCHANGE_RMA, progress == PROGRESS_THREAD ? PROGRESS_NONE : progress),
+rmaWin(MPI_WIN_NULL),
+rmaGroup(MPI_GROUP_NULL)
+{
+}
+
+
+RmaExchanger::~RmaExchanger(void)
+{
+    freeRma();
+}
+
+
+void RmaExchanger::release(void)
+{
+    HaloExchanger::release();
+    freeRma();
+}
+
+
+void RmaExchanger::freeRma(void)
+{
+    if(rmaWin != MPI_WIN_NULL)
+        MPI_assert( MPI_Win_free(&rmaWin), "Win free failed" LOCATION);
+
+    if(rmaGroup != MPI_GROUP_NULL)
+        MPI_assert( MPI_Group_free(&rmaGroup) LOCATION);
+}
+
+
+void RmaExchanger::planBackend(void)
+{
+    freeRma();
+
+    unsigned len = 0;
+
+    for(auto n : *bd.neighbors){
+        const Neighbor & nb = bd.nData->at(n);
+        len = std::max(len, nb.displ + nb.count);
+    }
+
+    MPI_assert( MPI_Win_create(hb->recvTemp, len * sizeof(float), sizeof(float), MPI_INFO_NULL, comm, &rmaWin),
+                "Win create failed" LOCATION);
+
+    // comm is copy of COMM_WORLD, neighbors keep their ranks
+    MPI_Group group;
+
+    MPI_assert( MPI_Comm_group(comm, &group) LOCATION);
+    MPI_assert( MPI_Group_incl(group, bd.neighbors->size(), bd.neighbors->data(), &rmaGroup) LOCATION);
+    MPI_assert( MPI_Group_free(&group) LOCATION);
+}
+
+
+void RmaExchanger::post(float * block)
+{
+    HaloToBuff<float>(block, hb->sendTemp, bd, ext);
+
+    // receive buffer is free, neighbors may put into it
+    MPI_assert( MPI_Win_post(rmaGroup, 0, rmaWin), "Win post failed" LOCATION);
+    MPI_assert( MPI_Win_start(rmaGroup, 0, rmaWin), "Win start failed" LOCATION);
+
+    for(auto n : *bd.neighbors){
+
+        const Neighbor & nb = bd.nData->at(n);
+
+        MPI_assert( MPI_Put(hb->sendTemp + nb.sendDispl, nb.sendCount, MPI_FLOAT,
+                            n, nb.putDispl, nb.sendCount, MPI_FLOAT, rmaWin),
+                    "Put failed" LOCATION);
+    }
+}
+
+
+void RmaExchanger::finish(float * block)
+{
+    // puts of this rank are done, then puts of neighbors
+    MPI_assert( MPI_Win_complete(rmaWin), "Win complete failed" LOCATION);
+    MPI_assert( MPI_Win_wait(rmaWin), "Win wait failed" LOCATION);
+
+    BuffToHalo<float>(block, hb->recvTemp, bd, ext);
+}
@@ -0,0 +1,422 @@
+/***********************************************
+*
+*  File Name:       HaloExchanger.h
+*
+*  Project:         Dynamic Load Balancing in HPC Applications
+*                   DIP (SC@FIT)
+*
+*  Description:     Halo zone exchange using requests
+*                   created once per topology, one class per backend
+*
+***********************************************/
+
+#ifndef __DLB_HALO_EXCHANGER_H__
+#define __DLB_HALO_EXCHANGER_H__
+
+#include <mpi.h>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <Asserts.h>
+#include <BlockData.h>
+#include <HaloBuffers.h>
+#include <TopologyDescriptor.h>
+
+using std::vector;
+
+namespace DLB {
+
+/**
+ * Progress of started halo exchange
+ *
+ * PROGRESS_NONE   - MPI progresses in wait() only
+ * PROGRESS_POLL   - computation calls test() periodically
+ * PROGRESS_THREAD - helper thread calls MPI_Testall until exchange
+ *                   completes, requires MPI_THREAD_MULTIPLE
+ */
+typedef enum progress { PROGRESS_NONE = 0, PROGRESS_POLL, PROGRESS_THREAD } TProgress;
+
+
+/**
+ * @brief Template function copying halo zone
+ *        to linear buffer, to be send over MPI.
+ *
+ * @details Copies rectangle requested by every neighbor,
+ *          neighbors are ordered by rank (see TopologyDescriptor::countDispls).
+ *
+ * @param block - original data block
+ * @param buff - allocated buffer with sufficient size (DBD::getHaloLen())
+ * @param bd - BlockData holding neighbor metadata
+ * @param ext - size of block including halo zones
+ */
+
+template <class T>
+void HaloToBuff(T * block, T * buff, const BlockData & bd, Dims ext)
+{
+    for(auto n : *bd.neighbors){
+
+      const Neighbor & nb = bd.nData->at(n);
+      T * dst = buff + nb.sendDispl;
+
+      for(unsigned i = 0; i < nb.sendSize.y; i++){
+
+        std::memcpy(dst, &(block[(nb.sendPos.y + i) * ext.x + nb.sendPos.x]), nb.sendSize.x * sizeof(T));
+        dst += nb.sendSize.x;
+      }
+    }
+}
+
+/**
+ * @brief Copies data from linear buffer to halo zones.
+ *
+ * @details Inverse to HaloToBuff, rectangle received from every
+ *          neighbor is stored to its place in halo zone.
+ *
+ * @param block - original data block
+ * @param buff - allocated buffer with sufficient size (DBD::getHaloLen())
+ * @param bd - BlockData holding neighbor metadata
+ * @param ext - size of block including halo zones
+ */
+
+template <class T>
+void BuffToHalo(T * block, T * buff, const BlockData & bd, Dims ext)
+{
+    for(auto n : *bd.neighbors){
+
+      const Neighbor & nb = bd.nData->at(n);
+      T * src = buff + nb.displ;
+
+      for(unsigned i = 0; i < nb.recvSize.y; i++){
+
+        std::memcpy(&(block[(nb.recvPos.y + i) * ext.x + nb.recvPos.x]), src, nb.recvSize.x * sizeof(T));
+        src += nb.recvSize.x;
+      }
+    }
+}
+
+
+/**
+ * @brief Exchanges halo zones with neighbors
+ *
+ * @details Requests for temperature exchange are created by plan()
+ *          once per topology, every step only starts and completes them.
+ *          Base class drives the exchange (progress modes, counters),
+ *          backends implement planBackend(), post() and finish(),
+ *          see create(). Requests of backend are kept in requests[0],
+ *          backends alternating between two buffers use requests[1] as well.
+ */
+
+class HaloExchanger {
+
+public:
+
+	/**
+	 * @brief Creates exchanger of given backend
+	 *
+	 * @param exchange - halo exchange backend (TExchange), not EXCHANGE_AUTO
+	 * @param progress - progress mode (TProgress)
+	 */
+	static HaloExchanger * create(int exchange, int progress = PROGRESS_NONE);
+
+	virtual ~HaloExchanger(void);
+
+	/**
+	 * @brief Creates requests for temperature halo exchange
+	 * @details Must be called after every topology change, persistent
+	 * 			requests are bound to HaloBuffers arrays (or to bd.oldTemp
+	 * 			and bd.newTemp with EXCHANGE_DATATYPE).
+	 *
+	 * @param bd - BlockData of actual topology
+	 * @param hb - halo buffers, sized by getBufferLen()
+	 * @param ext - size of block including halo zones
+	 */
+	void plan(const BlockData & bd, HaloBuffers & hb, Dims ext);
+
+	/**
+	 * @brief Frees requests (windows) bound to HaloBuffers
+	 * @details Must be called before HaloBuffers are resized or destroyed,
+	 * 			plan() has to follow before next exchange. Collective.
+	 */
+	virtual void release(void);
+
+	/**
+	 * @brief Packs halo zone of given temperature block and starts exchange
+	 */
+	void start(float * block);
+
+	/**
+	 * @brief Waits for exchange started by start() and unpacks halo zone
+	 */
+	void wait(float * block);
+
+	/**
+	 * @brief Drives MPI progress of started exchange (PROGRESS_POLL)
+	 * @details Does nothing in other modes or if exchange is completed.
+	 */
+	void test(void);
+
+	/**
+	 * @brief Blocking exchange of temperature halo zone on topology change,
+	 * 		  must be called after plan().
+	 * @details Halo zone is stored to both oldTemp and newTemp,
+	 * 			domain border points in halo zone are never computed.
+	 * 			Static fields (params, map) migrate with their halo frames,
+	 * 			see DBD::getFrameSize.
+	 */
+	void exchangeInit(void);
+
+	int getExchange(void) const { return exchange; }
+
+	/**
+	 * @brief Returns size of HaloBuffers needed by the backend
+	 * @param haloLen - DBD::getHaloLen()
+	 */
+	virtual unsigned getBufferLen(unsigned haloLen) const { return haloLen; }
+
+	/**
+	 * @brief Counters of completed exchanges
+	 * @details Bytes sent to neighbors and time from start() to the end
+	 * 			of wait(), summed over exchanges since resetCounters().
+	 */
+	unsigned getExchanges(void) const { return exchanges; }
+	double getBytes(void) const { return bytes; }
+	double getTime(void) const { return time; }
+
+	void resetCounters(void);
+
+protected:
+
+	HaloExchanger(int exchange, int progress);
+
+	// creates requests (windows) of actual topology, called by plan()
+	virtual void planBackend(void) = 0;
+
+	// packs halo zone and posts requests, sets active
+	virtual void post(float * block) = 0;
+
+	// completes exchange after active requests, unpacks halo zone
+	virtual void finish(float * block) = 0;
+
+	void freeRequests(void);
+
+	// PROGRESS_THREAD helper, tests active requests after each start()
+	void progressLoop(void);
+
+	// halo exchange backend (TExchange)
+	int exchange;
+
+	// private copy of COMM_WORLD for point to point messages
+	MPI_Comm comm;
+
+	// actual topology
+	BlockData bd;
+	HaloBuffers * hb;
+	Dims ext;
+
+	vector<MPI_Request> requests[2];
+	vector<MPI_Status> statuses;
+
+	// requests started by start()
+	vector<MPI_Request> * active;
+
+	// requests are persistent, must be freed
+	bool persistent;
+
+	// progress mode (TProgress)
+	int progress;
+
+	// started exchange completed by test()
+	bool completed;
+
+	std::thread progressThread;
+	std::mutex progressLock;
+	std::condition_variable progressCv;
+	bool progressPending;
+	bool progressStop;
+
+	// bytes sent per exchange, counters
+	double sendBytes;
+	unsigned exchanges;
+	double bytes;
+	double time;
+	double startTime;
+
+	static const int TAG_TEMP = 1;
+	static const int TAG_DISPL = 2;
+
+};
+
+
+/**
+ * @brief EXCHANGE_SCATTER, Iscatterv posted every step
+ */
+class ScatterExchanger : public HaloExchanger {
+
+public:
+
+	ScatterExchanger(int progress) : HaloExchanger(EXCHANGE_SCATTER, progress) {}
+
+protected:
+
+	void planBackend(void);
+	void post(float * block);
+	void finish(float * block);
+
+	// Iscatterv counts and displs, including this tile
+	vector<int> cnts, displs;
+};
+
+
+/**
+ * @brief EXCHANGE_NEIGHBOR, persistent neighborhood collective
+ * 		  if MPI-4 is available, Ineighbor_alltoallv otherwise
+ */
+class NeighborExchanger : public HaloExchanger {
+
+public:
+
+	NeighborExchanger(int progress) : HaloExchanger(EXCHANGE_NEIGHBOR, progress) {}
+
+protected:
+
+	void planBackend(void);
+	void post(float * block);
+	void finish(float * block);
+};
+
+
+/**
+ * @brief EXCHANGE_PERSISTENT, MPI_Send_init/MPI_Recv_init
+ */
+class PersistentExchanger : public HaloExchanger {
+
+public:
+
+	PersistentExchanger(int progress) : HaloExchanger(EXCHANGE_PERSISTENT, progress) {}
+
+protected:
+
+	void planBackend(void);
+	void post(float * block);
+	void finish(float * block);
+};
+
+
+/**
+ * @brief EXCHANGE_DATATYPE, sends and receives directly from/to the
+ *        temperature block using subarray types cached by TopologyDescriptor,
+ *        one set of persistent requests is created for each temperature array.
+ */
+class DatatypeExchanger : public HaloExchanger {
+
+public:
+
+	DatatypeExchanger(int progress) : HaloExchanger(EXCHANGE_DATATYPE, progress) {}
+
+	unsigned getBufferLen(unsigned) const { return 0; }
+
+protected:
+
+	void planBackend(void);
+	void post(float * block);
+	void finish(float * block);
+
+	// requests[i] are bound to typeBlocks[i]
+	float * typeBlocks[2];
+};
+
+
+/**
+ * @brief EXCHANGE_SHARED, packs halo zones to shared window of node, neighbors
+ *        on the node copy their rectangles directly from it when flag of
+ *        owner reaches actual epoch. Buffers of odd and even epochs alternate,
+ *        owner may be one epoch ahead only, so no acknowledgement is needed.
+ */
+class SharedExchanger : public HaloExchanger {
+
+public:
+
+	SharedExchanger(int progress);
+
+	~SharedExchanger(void);
+
+	/**
+	 * @brief True if neighbor shares node window
+	 */
+	bool isShared(int n) const;
+
+protected:
+
+	// allocates window of actual topology, collective on node
+	void planBackend(void);
+	void post(float * block);
+	void finish(float * block);
+
+	// frees window, collective on node
+	void freeShared(void);
+
+	// ranks of node and their window
+	MPI_Comm nodeComm;
+	MPI_Win shmWin;
+
+	// my part of window, epoch flag and two send buffers of shmLen floats
+	volatile long long * shmFlag;
+	float * shmSend[2];
+	unsigned shmLen;
+	long long epoch;
+
+	// neighbor on the node, his flag and buffers, displacement of my rectangle
+	struct ShmPeer {
+		int rank;
+		volatile long long * flag;
+		float * send[2];
+		unsigned displ;
+	};
+
+	vector<ShmPeer> shmPeers;
+
+	// window part starts with flag, buffers are aligned to cache line
+	static const int SHM_HEADER = 64;
+};
+
+
+/**
+ * @brief EXCHANGE_RMA, exposes receive buffer in window, start() puts packed
+ *        rectangles to neighbors within access epoch, wait() closes both
+ *        access and exposure epochs (post-start-complete-wait).
+ *        PSCW has no requests to test, PROGRESS_THREAD is replaced
+ *        by PROGRESS_NONE.
+ */
+class RmaExchanger : public HaloExchanger {
+
+public:
+
+	RmaExchanger(int progress);
+
+	~RmaExchanger(void);
+
+	void release(void);
+
+protected:
+
+	// creates window over receive buffer, collective
+	void planBackend(void);
+	void post(float * block);
+	void finish(float * block);
+
+	// frees window and group, collective
+	void freeRma(void);
+
+	// window over HaloBuffers::recvTemp and group of neighbors
+	MPI_Win rmaWin;
+	MPI_Group rmaGroup;
+};
+
+
+} //DLB nspace end
+
+#endif
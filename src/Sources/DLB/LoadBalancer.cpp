@@ -26,12 +26,18 @@ using std::accumulate;
 using std::for_each;
 
 
-LoadBalancer::LoadBalancer(int rank, size_t edgeSize,  int worldSize, Dims objectSize, double threshold):
+LoadBalancer::LoadBalancer(int rank, size_t edgeSize,  int worldSize, Dims objectSize, double threshold,
+                           int strategy, unsigned hysteresis, bool nodeAware):
 edgeSize(edgeSize),
 rank(rank),
 worldSize(worldSize),
 objectSize(objectSize),
-threshold(threshold)
+threshold(threshold),
+strategy(strategy),
+hysteresis(std::max(1u, hysteresis)),
+nodeAware(nodeAware),
+imbalancedPeriods(0),
+regularPeriods(0)
 {
     // init empty values
     zz = NULL; // Zoltan null until created from DBD::zoltanInit()
@@ -165,6 +171,16 @@ vector<TileDescriptor> * LoadBalancer::regularTiles(void)
     cols = edgeSize / blockSize.x; // blocks in row = cols
     rows = edgeSize / blockSize.y; // blocks in col = rows
 
+    if(slots.size() != rows * cols){
+
+        placeSlots();
+
+        slotOf.resize(slots.size());
+
+        for(unsigned s = 0; s < slots.size(); s++)
+            slotOf[slots[s]] = s;
+    }
+
   // working directly on vector
 
     int tmpRank = 0;
@@ -173,7 +189,7 @@ vector<TileDescriptor> * LoadBalancer::regularTiles(void)
 
             TileDescriptor tempTd;
 
-            tempTd.setRank(tmpRank);
+            tempTd.setRank(rankAt(tmpRank));
             tempTd.setPosition( Dims(c * blockSize.x, r * blockSize.y) );
             tempTd.setSize( Dims( blockSize.x, blockSize.y) );
             tls->push_back(tempTd);
@@ -186,12 +202,120 @@ vector<TileDescriptor> * LoadBalancer::regularTiles(void)
     if(tmpRank > worldSize + 1)
         throw runtime_error("regularTiles: rank out of bounds");
 
+    // tiles are ordered by rank
+    std::sort(tls->begin(), tls->end(),
+              [](const TileDescriptor & a, const TileDescriptor & b){ return a.getRank() < b.getRank(); });
+
 
     return tls;
 }
 
 
 
+void LoadBalancer::placeSlots(void)
+{
+    slots.resize(rows * cols);
+
+    // row-major unless nodes tile the mesh
+    for(unsigned s = 0; s < slots.size(); s++)
+        slots[s] = s;
+
+    if(hosts.size() != slots.size())
+        return;
+
+    // ranks of every node, nodes are numbered by their first rank
+    vector<TileDescriptor> tmp(hosts.size());
+
+    for(unsigned k = 0; k < hosts.size(); k++){
+        tmp[k].setRank(k);
+        tmp[k].setHostNumber(hosts[k]);
+    }
+
+    vector<int> node = nodesOf(tmp);
+    vector<vector<int>> ranks(*max_element(node.begin(), node.end()) + 1);
+
+    for(unsigned k = 0; k < node.size(); k++)
+        ranks[node[k]].push_back(k);
+
+    unsigned p = ranks[0].size();
+
+    if(!std::all_of(ranks.begin(), ranks.end(), [p](const vector<int> & v){ return v.size() == p; })){
+
+        if(rank == 0) cout << "placement: nodes differ in size, row-major placement kept" << endl;
+        return;
+    }
+
+    // node owns block of bh x bw slots, the most square one
+    unsigned bh = 0, bw = 0;
+
+    for(unsigned h = 1; h <= p; h++){
+
+        if(p % h != 0 || rows % h != 0 || cols % (p / h) != 0)
+            continue;
+
+        if(bh == 0 || h + p / h < bh + bw){
+            bh = h;
+            bw = p / h;
+        }
+    }
+
+    if(bh == 0){
+
+        if(rank == 0) cout << "placement: nodes do not tile mesh, row-major placement kept" << endl;
+        return;
+    }
+
+    // blocks of nodes in row-major order, ranks of node row-major within block
+    unsigned blocksInRow = cols / bw;
+
+    for(unsigned n = 0; n < ranks.size(); n++){
+
+        unsigned r0 = (n / blocksInRow) * bh;
+        unsigned c0 = (n % blocksInRow) * bw;
+
+        for(unsigned k = 0; k < p; k++)
+            slots[(r0 + k / bw) * cols + c0 + k % bw] = ranks[n][k];
+    }
+}
+
+int LoadBalancer::leftOf(int rank) const
+{
+    unsigned s = slotOf[rank];
+
+    return s % cols == 0 ? (int) MPI_PROC_NULL : slots[s - 1];
+}
+
+int LoadBalancer::rightOf(int rank) const
+{
+    unsigned s = slotOf[rank];
+
+    return s % cols == cols - 1 ? (int) MPI_PROC_NULL : slots[s + 1];
+}
+
+int LoadBalancer::aboveOf(int rank) const
+{
+    unsigned s = slotOf[rank];
+
+    return s < cols ? (int) MPI_PROC_NULL : slots[s - cols];
+}
+
+int LoadBalancer::belowOf(int rank) const
+{
+    unsigned s = slotOf[rank];
+
+    return s + cols >= rows * cols ? (int) MPI_PROC_NULL : slots[s + cols];
+}
+
+vector<TileDescriptor> LoadBalancer::inSlots(const vector<TileDescriptor> & tiles)
+{
+    vector<TileDescriptor> tls;
+
+    for(unsigned s = 0; s < rows * cols; s++)
+        tls.push_back(*find(tiles.begin(), tiles.end(), rankAt(s)));
+
+    return tls;
+}
+
 bool LoadBalancer::isBalanced(vector<double> & times)
 {
     if(DBG){
@@ -231,9 +355,55 @@ bool LoadBalancer::isBalanced(vector<double> & times)
  * @return [description]
  */
 
-vector<unsigned> LoadBalancer::splitByPerform(const vector<double> & times)
+int LoadBalancer::decide(vector<double> & times, const vector<TileDescriptor> & tiles)
+{
+    if(!isBalanced(times)){
+
+        regularPeriods = 0;
+
+        if(++imbalancedPeriods < hysteresis)
+            return BALANCE_NONE;
+
+        imbalancedPeriods = 0;
+        return BALANCE_PARTITION;
+    }
+
+    imbalancedPeriods = 0;
+
+    if(!imbalance)
+        return BALANCE_NONE;
+
+    // time of rank predicted on regular tile, time scales with objects count
+    vector<TileDescriptor> * reg = regularTiles();
+    vector<double> predicted;
+
+    for(unsigned k = 0; k < times.size(); k++){
+
+        Dims s = (*find(tiles.begin(), tiles.end(), k)).getSize();
+        Dims r = (*find(reg->begin(), reg->end(), k)).getSize();
+
+        predicted.push_back(times[k] * double(r.x * r.y) / double(s.x * s.y));
+    }
+
+    delete reg;
+
+    double pmax = *max_element(predicted.begin(), predicted.end());
+    double pmin = *min_element(predicted.begin(), predicted.end());
+
+    if(pmax > pmin * (1.0 + (threshold - 1.0) / 2.0)){
+        regularPeriods = 0;
+        return BALANCE_NONE;
+    }
+
+    if(++regularPeriods < hysteresis)
+        return BALANCE_NONE;
+
+    regularPeriods = 0;
+    return BALANCE_REGULAR;
+}
+
+vector<unsigned> LoadBalancer::splitByPerform(const vector<double> & times, unsigned objects)
 {   
-    vector<unsigned> objects;
     vector<unsigned> sizes;
     vector<double> normalized = times;
 
@@ -252,8 +422,11 @@ vector<unsigned> LoadBalancer::splitByPerform(const vector<double> & times)
 
     // for(float x: normalized) cout << std::fixed << std::setprecision(2) << x << " "; cout << endl;
 
+    if(objects == 0)
+        objects = objCols;
+
     double sum = accumulate(normalized.begin(), normalized.end(),0.0);
-    double unit = objCols / sum; // unit amount of objects relative to norm. values
+    double unit = objects / sum; // unit amount of objects relative to norm. values
 
     for_each(normalized.begin(), normalized.end(), [unit](double &t){ t = t * unit; });
 
@@ -273,16 +446,17 @@ vector<unsigned> LoadBalancer::splitByPerform(const vector<double> & times)
     // if sum of assigned objects do not match, simpley spread the rest between
     // may be optimized by selecting parts
 
-    if(objSum != objCols){
-        int dif = objSum - objCols;
+    if(objSum != objects){
+        int dif = objSum - objects;
         unsigned absval = abs(dif);
 
         if(dif > 0){ 
             //more object assigned than exist
             //more likely because of ceiling
 
+            // largest parts, no part may become empty
             for(unsigned d = 0; d < absval;d++){
-                sizes[d % sizes.size()] -= 1;
+                *max_element(sizes.begin(), sizes.end()) -= 1;
             }
         }else{ //some objects not assigned
 
@@ -296,22 +470,402 @@ vector<unsigned> LoadBalancer::splitByPerform(const vector<double> & times)
 
 }
 
+vector<unsigned> LoadBalancer::splitByCost(const vector<double> & perf, const vector<double> & line)
+{
+    unsigned n = perf.size();
+
+    double total = accumulate(line.begin(), line.end(), 0.0);
+    double perfSum = accumulate(perf.begin(), perf.end(), 0.0);
+
+    // nothing measured, objects of equal cost
+    if(total <= 0.0 || perfSum <= 0.0)
+        return splitByPerform(vector<double>(n, 1.0), line.size());
+
+    vector<unsigned> sizes;
+
+    unsigned begin = 0;
+    double acc = 0.0;
+    double share = 0.0;
+
+    for(unsigned k = 0; k + 1 < n; k++){
+
+        share += perf[k] / perfSum;
+        double target = total * share;
+
+        // at least one object, keep one object for every remaining part
+        unsigned end = begin + 1;
+        acc += line[begin];
+
+        while(end < line.size() - (n - k - 1) && fabs(acc + line[end] - target) < fabs(acc - target)){
+            acc += line[end];
+            end++;
+        }
+
+        sizes.push_back(end - begin);
+        begin = end;
+    }
+
+    sizes.push_back(line.size() - begin);
+
+    return sizes;
+}
+
+double LoadBalancer::costOf(const vector<double> & costs, unsigned x, unsigned y, unsigned w, unsigned h)
+{
+    double sum = 0.0;
+
+    for(unsigned i = y; i < y + h; i++)
+        for(unsigned j = x; j < x + w; j++)
+            sum += costs[i * objCols + j];
+
+    return sum;
+}
+
+vector<int> LoadBalancer::nodesOf(const vector<TileDescriptor> & tiles)
+{
+    map<int, int> index;
+    vector<int> node;
+
+    for(auto & t : tiles){
+
+        auto it = index.find(t.getHostNumber());
+
+        if(it == index.end())
+            it = index.insert(pair<int, int>(t.getHostNumber(), index.size())).first;
+
+        node.push_back(it->second);
+    }
+
+    return node;
+}
+
+bool LoadBalancer::nodesBalanced(const vector<double> & perf, const vector<double> & work, const vector<int> & node)
+{
+    unsigned nodes = *max_element(node.begin(), node.end()) + 1;
+
+    vector<double> nodePerf(nodes, 0.0), nodeWork(nodes, 0.0);
+
+    for(unsigned k = 0; k < node.size(); k++){
+        nodePerf[node[k]] += perf[k];
+        nodeWork[node[k]] += work[k];
+    }
+
+    vector<double> times;
+
+    for(unsigned n = 0; n < nodes; n++)
+        times.push_back(nodeWork[n] / nodePerf[n]);
+
+    return isBalanced(times);
+}
+
+vector<unsigned> LoadBalancer::splitByNode(const vector<double> & perf, const vector<int> & node,
+                                           const vector<unsigned> & current, const vector<double> & line, bool keep)
+{
+    // segments of consecutive parts on the same node, [first, last)
+    vector<unsigned> first;
+    vector<double> segPerf;
+    vector<unsigned> segSize;
+
+    for(unsigned k = 0; k < perf.size(); k++){
+
+        if(k == 0 || node[k] != node[k - 1]){
+            first.push_back(k);
+            segPerf.push_back(0.0);
+            segSize.push_back(0);
+        }
+
+        segPerf.back() += perf[k];
+        segSize.back() += current[k];
+    }
+
+    first.push_back(perf.size());
+
+    // the first level, objects cross node boundaries
+    if(!keep)
+        segSize = splitByCost(segPerf, line);
+
+    // the second level, within node
+    vector<unsigned> sizes;
+    unsigned begin = 0;
+
+    for(unsigned s = 0; s + 1 < first.size(); s++){
+
+        // every part keeps at least one object
+        unsigned parts = first[s + 1] - first[s];
+        unsigned after = perf.size() - first[s + 1];
+        unsigned size = std::min(std::max(segSize[s], parts), (unsigned) line.size() - begin - after);
+
+        vector<double> seg(line.begin() + begin, line.begin() + begin + size);
+        vector<unsigned> part = splitByCost(vector<double>(perf.begin() + first[s], perf.begin() + first[s + 1]), seg);
+
+        sizes.insert(sizes.end(), part.begin(), part.end());
+        begin += size;
+    }
+
+    // rounding of segments, the rest is given to the last part
+    sizes.back() += line.size() - begin;
+
+    return sizes;
+}
+
+double LoadBalancer::costOf(const vector<double> & costs, const TileDescriptor & t)
+{
+    Dims p = t.getPosition();
+    Dims s = t.getSize();
+
+    return costOf(costs, p.x / objectSize.x, p.y / objectSize.y, s.x / objectSize.x, s.y / objectSize.y);
+}
+
+double LoadBalancer::predictMax(const vector<double> & times, const vector<TileDescriptor> & tiles,
+                                const vector<TileDescriptor> & newTiles, const vector<double> & costs)
+{
+    vector<double> c = costs.empty() ? vector<double>(objRows * objCols, 1.0) : costs;
+    double result = 0.0;
+
+    for(unsigned k = 0; k < times.size(); k++){
+
+        double done = costOf(c, *find(tiles.begin(), tiles.end(), k));
+        double work = costOf(c, *find(newTiles.begin(), newTiles.end(), k));
+
+        result = std::max(result, done > 0.0 ? times[k] * work / done : times[k]);
+    }
+
+    return result;
+}
+
+unsigned LoadBalancer::movedObjects(const vector<TileDescriptor> & tiles, const vector<TileDescriptor> & newTiles)
+{
+    unsigned moved = 0;
+
+    for(auto & n : newTiles){
+
+        const TileDescriptor & o = *find(tiles.begin(), tiles.end(), n.getRank());
+
+        // overlap of old and new tile of the same rank stays in place
+        int w = (int) std::min(o.getPosition().x + o.getSize().x, n.getPosition().x + n.getSize().x)
+                - (int) std::max(o.getPosition().x, n.getPosition().x);
+        int h = (int) std::min(o.getPosition().y + o.getSize().y, n.getPosition().y + n.getSize().y)
+                - (int) std::max(o.getPosition().y, n.getPosition().y);
+
+        unsigned kept = w > 0 && h > 0 ? w * h : 0;
+
+        moved += (n.getSize().x * n.getSize().y - kept) / (objectSize.x * objectSize.y);
+    }
+
+    return moved;
+}
+
+int LoadBalancer::edgeShift(double tl, unsigned wl, double tr, unsigned wr) const
+{
+    if(std::max(tl, tr) <= std::min(tl, tr) * threshold)
+        return 0;
+
+    // objects per second, pair is split proportionally
+    double pl = wl / tl;
+    double pr = wr / tr;
+
+    double target = (wl + wr) * pl / (pl + pr);
+    int shift = round(DIFFUSION_RATE * (target - wl));
+
+    // both edges of tile may shrink it, each takes at most half
+    shift = std::max(shift, - (int) (wl - 1) / 2);
+    shift = std::min(shift, (int) (wr - 1) / 2);
+
+    return shift;
+}
+
+bool LoadBalancer::isRowLayout(const vector<TileDescriptor> & tiles)
+{
+    if(tiles.size() != rows * cols)
+        return false;
+
+    unsigned posY = 0;
+
+    for(unsigned i = 0; i < rows;i++){
+
+        unsigned pos = 0;
+        const TileDescriptor & first = tiles[rankAt(i*cols)];
+
+        for(unsigned j = 0; j < cols;j++){
+
+            const TileDescriptor & t = tiles[rankAt(i*cols + j)];
+
+            if(t.getRank() != rankAt(i*cols + j) || t.getPosition().x != pos || t.getPosition().y != posY ||
+               t.getSize().y != first.getSize().y)
+                return false;
+
+            pos += t.getSize().x;
+        }
+
+        posY += first.getSize().y;
+    }
+
+    return true;
+}
+
+vector<TileDescriptor> * LoadBalancer::interpolate(const vector<TileDescriptor> & from,
+                                                   const vector<TileDescriptor> & to, double f)
+{
+    vector<TileDescriptor> * tls = new vector<TileDescriptor>(to);
+
+    // edge in objects, positions between objects are rounded the same way on all ranks
+    auto edge = [f](unsigned a, unsigned b, unsigned obj){
+        return (unsigned) floor(((1.0 - f) * (a / obj) + f * (b / obj)) + 0.5) * obj;
+    };
+
+    for(unsigned i = 0; i < rows;i++){
+
+        const TileDescriptor & fr = from[rankAt(i*cols)];
+        const TileDescriptor & tr = to[rankAt(i*cols)];
+
+        unsigned top = edge(fr.getPosition().y, tr.getPosition().y, objectSize.y);
+        unsigned bottom = edge(fr.getPosition().y + fr.getSize().y, tr.getPosition().y + tr.getSize().y, objectSize.y);
+
+        for(unsigned j = 0; j < cols;j++){
+
+            unsigned k = rankAt(i*cols + j);
+
+            const TileDescriptor & ft = from[k];
+            const TileDescriptor & tt = to[k];
+
+            unsigned left = edge(ft.getPosition().x, tt.getPosition().x, objectSize.x);
+            unsigned right = edge(ft.getPosition().x + ft.getSize().x, tt.getPosition().x + tt.getSize().x, objectSize.x);
+
+            tls->at(k).setPosition(Dims(left, top));
+            tls->at(k).setSize(Dims(right - left, bottom - top));
+        }
+    }
+
+    return tls;
+}
+
+vector<TileDescriptor> * LoadBalancer::budgetStep(const vector<TileDescriptor> & from,
+                                                  const vector<TileDescriptor> & to, unsigned budget, bool & last)
+{
+    last = movedObjects(from, to) <= budget;
+
+    if(last)
+        return new vector<TileDescriptor>(to);
+
+    // moved objects grow with f, lo fits into budget, hi does not
+    double lo = 0.0, hi = 1.0;
+
+    for(int i = 0; i < 32; i++){
+
+        double mid = (lo + hi) / 2.0;
+        vector<TileDescriptor> * tls = interpolate(from, to, mid);
+
+        if(movedObjects(from, *tls) <= budget)
+            lo = mid;
+        else
+            hi = mid;
+
+        delete tls;
+    }
+
+    vector<TileDescriptor> * step = interpolate(from, to, lo);
+
+    // budget is lower than the smallest step
+    if(movedObjects(from, *step) == 0){
+        delete step;
+        step = interpolate(from, to, hi);
+    }
+
+    // the smallest step may reach to
+    last = movedObjects(*step, to) == 0;
+
+    return step;
+}
+
+const char * LoadBalancer::zoltanMethod(void) const
+{
+    switch(strategy){
+        case STRATEGY_RCB:  return "RCB";
+        case STRATEGY_RIB:  return "RIB";
+        case STRATEGY_HSFC: return "HSFC";
+        default:            return "NONE";
+    }
+}
+
 vector<TileDescriptor> * LoadBalancer::getPartition(  const vector<double> & times,
-                                        const vector<TileDescriptor> & tiles
+                                        const vector<TileDescriptor> & tiles,
+                                        const vector<double> & costs
                                     )
 {
-    // objCols = edgeSize / objectSize.x;
-    // objRows = edgeSize / objectSize.y;
-
-    vector<TileDescriptor> byRow;
     vector<TileDescriptor> * newTiles = new vector<TileDescriptor>();
-    // vector<TileDescriptor> row;
-    vector<unsigned> sizeOnRow;;
-    
-    auto it = times.begin();
-    auto tileIt = tiles.begin();
+    vector<unsigned> sizeOnRow;
+
+    // objects of equal cost if not sampled
+    vector<double> c = costs.empty() ? vector<double>(objRows * objCols, 1.0) : costs;
+
+    // tiles of geometric strategy may not form rows,
+    // rows of regular layout are split then
+    vector<TileDescriptor> base = tiles;
+
+    if(isGeometric()){
+
+        vector<TileDescriptor> * reg = regularTiles();
+
+        for(auto & t : *reg)
+            t.setHostNumber( (*find(tiles.begin(), tiles.end(), t.getRank())).getHostNumber() );
+
+        base = *reg;
+        delete reg;
+    }
+
+    // rows are split in slots of regular mesh, new tiles are ordered by rank again
+    base = inSlots(base);
+
+    auto tileIt = base.begin();
     unsigned pos = 0;
 
+    // heights of rows in objects, STRATEGY_2D only
+    vector<unsigned> heights;
+    unsigned posY = 0;
+
+    // performance of every rank - work done per second on actual tile,
+    // time of slow rank is not blamed on its objects
+    vector<double> perf;
+
+    for(unsigned s = 0; s < base.size(); s++)
+        perf.push_back(costOf(c, tiles[rankAt(s)]) / times[rankAt(s)]);
+
+    // node of every slot, node level imbalance allows moves between nodes
+    vector<int> node(base.size(), 0);
+    bool keepNodes = false;
+
+    if(nodeAware && !isGeometric()){
+
+        vector<double> work;
+
+        for(unsigned s = 0; s < base.size(); s++)
+            work.push_back(costOf(c, tiles[rankAt(s)]));
+
+        node = nodesOf(base);
+        keepNodes = nodesBalanced(perf, work, node);
+    }
+
+    if(strategy == STRATEGY_2D){
+
+        vector<double> rowPerf, line;
+        vector<int> rowNode;
+        vector<unsigned> rowHeight;
+
+        for(unsigned i = 0; i < rows;i++){
+            rowPerf.push_back(accumulate(perf.begin() + i*cols, perf.begin() + (i+1)*cols, 0.0));
+            rowHeight.push_back(base[i*cols].getSize().y / objectSize.y);
+
+            // row shared by several nodes is segment of its own
+            bool single = std::count(node.begin() + i*cols, node.begin() + (i+1)*cols, node[i*cols]) == (int) cols;
+            rowNode.push_back(single ? node[i*cols] : -1 - (int) i);
+        }
+
+        for(unsigned y = 0; y < objRows;y++)
+            line.push_back(costOf(c, 0, y, objCols, 1));
+
+        heights = splitByNode(rowPerf, rowNode, rowHeight, line, keepNodes);
+    }
+
     // cout << COUTLOC << endl;
     // cout << "=Balance=" << endl;
 
@@ -320,7 +874,23 @@ vector<TileDescriptor> * LoadBalancer::getPartition(  const vector<double> & tim
 
     for(unsigned i = 0; i < rows;i++){
 
-        sizeOnRow = splitByPerform(vector<double>(it,it+cols));
+        // cost of object columns within the row of tiles
+        unsigned top = (strategy == STRATEGY_2D ? posY : tileIt->getPosition().y) / objectSize.y;
+        unsigned height = strategy == STRATEGY_2D ? heights[i] : tileIt->getSize().y / objectSize.y;
+
+        vector<double> line;
+
+        for(unsigned x = 0; x < objCols;x++)
+            line.push_back(costOf(c, x, top, 1, height));
+
+        vector<unsigned> widths;
+
+        for(unsigned k = i*cols; k < (i+1)*cols; k++)
+            widths.push_back(base[k].getSize().x / objectSize.x);
+
+        sizeOnRow = splitByNode(vector<double>(perf.begin() + i*cols, perf.begin() + (i+1)*cols),
+                                vector<int>(node.begin() + i*cols, node.begin() + (i+1)*cols),
+                                widths, line, keepNodes);
 
         // cout << "row: " << i << " ";
         // for(auto s: sizeOnRow) cout << s << ",";
@@ -336,6 +906,12 @@ vector<TileDescriptor> * LoadBalancer::getPartition(  const vector<double> & tim
             Dims s = temp.getSize();
             p.x = pos;
             s.x = sz * objectSize.x;
+
+            if(strategy == STRATEGY_2D){
+                p.y = posY;
+                s.y = heights[i] * objectSize.y;
+            }
+
             temp.setPosition(p);
             temp.setSize(s);
             // push modified tile
@@ -343,9 +919,14 @@ vector<TileDescriptor> * LoadBalancer::getPartition(  const vector<double> & tim
             pos += sz * objectSize.x; 
         }
         pos = 0; //begin new line
-        it += cols;
+
+        if(strategy == STRATEGY_2D)
+            posY += heights[i] * objectSize.y;
     }
     // cout << "==========" << endl;
+
+    std::sort(newTiles->begin(), newTiles->end(),
+              [](const TileDescriptor & a, const TileDescriptor & b){ return a.getRank() < b.getRank(); });
  
 
     return newTiles;
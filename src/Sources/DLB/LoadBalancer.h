@@ -41,6 +41,40 @@ using std::list;
 
 namespace DLB {
 
+/**
+ * Repartitioning strategy
+ *
+ * STRATEGY_WIDTHS - rows of tiles are fixed, widths of tiles are
+ *                   changed within every row
+ * STRATEGY_2D     - heights of rows are balanced by aggregate row
+ *                   performance first, then widths within every row
+ * STRATEGY_RCB,
+ * STRATEGY_RIB,
+ * STRATEGY_HSFC   - Zoltan geometric partitioner (LB_Partition) with object
+ *                   weights derived from measured times, computed in parallel.
+ *                   Parts must be rectangles, else widths strategy is used.
+ * STRATEGY_DIFFUSION - no root, every rank compares its load with right
+ *                   neighbor in row and moves the shared edge towards
+ *                   the slower side, rows of tiles do the same with
+ *                   the row below (see DBD::diffuse)
+ */
+typedef enum strategy { STRATEGY_WIDTHS = 0, STRATEGY_2D,
+                        STRATEGY_RCB, STRATEGY_RIB, STRATEGY_HSFC,
+                        STRATEGY_DIFFUSION } TStrategy;
+
+// part of load difference of neighbors moved by single diffusion step,
+// less than 1 damps oscillation of edge shared by overlapping pairs
+const double DIFFUSION_RATE = 0.5;
+
+/**
+ * Result of imbalance detection, broadcast by root
+ *
+ * BALANCE_NONE      - layout is kept
+ * BALANCE_PARTITION - new partition is computed from measured times
+ * BALANCE_REGULAR   - imbalance is gone, regular layout is restored
+ */
+typedef enum balancing { BALANCE_NONE = 0, BALANCE_PARTITION, BALANCE_REGULAR } TBalancing;
+
 /**
  * @brief Class providing main load balancing routines
  * 
@@ -55,30 +89,152 @@ class LoadBalancer
 
 public:
 
-	LoadBalancer(int rank, size_t edgeSize,  int worldSize, Dims objectSize, double threshold);
+	LoadBalancer(int rank, size_t edgeSize,  int worldSize, Dims objectSize, double threshold,
+				 int strategy = STRATEGY_WIDTHS, unsigned hysteresis = 1, bool nodeAware = false);
 	~LoadBalancer(void);
 	
 	/**
 	 * @brief 	Compute new decomposition based on actual state and 
 	 * 			measured performance data.
 	 * 
-	 * @details [long description]
+	 * @details Performance of rank is work done on its actual tile
+	 * 			per second, new tiles get work proportional to it.
 	 * 
 	 * @param pm [description]
-	 * @param tiles [description]
+	 * @param tiles - actual tiles ordered by rank, times were measured on them
+	 * @param costs - sampled cost of every object in domain (row-major),
+	 * 				  objects of equal cost are assumed if empty
 	 * 
 	 * @return [description]
 	 */
 	vector<TileDescriptor> * getPartition(	const vector<double> & pm,
-					  						const vector<TileDescriptor> & tiles
+					  						const vector<TileDescriptor> & tiles,
+					  						const vector<double> & costs = vector<double>()
 					  					);
 
 
-	vector<unsigned> splitByPerform(const vector<double> & times);
+	/**
+	 * @brief Splits objects between parts proportionally to performance (1/time)
+	 *
+	 * @param times - measured time of every part
+	 * @param objects - number of objects to split, objects in row if 0
+	 * @return number of objects of every part, at least 1
+	 */
+	vector<unsigned> splitByPerform(const vector<double> & times, unsigned objects = 0);
+
+	/**
+	 * @brief Cuts line of objects between parts proportionally to performance
+	 * @details Part gets share of summed cost of the line, not share of objects,
+	 * 			cuts are placed to the nearest object boundary.
+	 *
+	 * @param perf - performance of every part (cost per second)
+	 * @param line - cost of every object (or object column/row) on the line
+	 * @return number of objects of every part, at least 1
+	 */
+	vector<unsigned> splitByCost(const vector<double> & perf, const vector<double> & line);
+
+	/**
+	 * @brief True if partition is computed by Zoltan LB_Partition
+	 */
+	bool isGeometric(void) const	{ return strategy >= STRATEGY_RCB && strategy <= STRATEGY_HSFC; }
+
+	bool isDiffusion(void) const	{ return strategy == STRATEGY_DIFFUSION; }
+
+	/**
+	 * @brief Shift of edge shared by neighbors in row, in objects
+	 * @details Positive shift moves edge right. Every tile keeps at least
+	 * 			one object even if both its edges shift towards each other.
+	 *
+	 * @param tl, wl - time and width (objects) of left tile
+	 * @param tr, wr - time and width (objects) of right tile
+	 */
+	int edgeShift(double tl, unsigned wl, double tr, unsigned wr) const;
+
+	/**
+	 * @brief Zoltan LB_METHOD of geometric strategy
+	 */
+	const char * zoltanMethod(void) const;
 
 
+	/**
+	 * @brief Regular mesh, tiles ordered by rank
+	 * @details Ranks are assigned to slots of mesh (row-major position)
+	 * 			by placement, see setHosts.
+	 */
 	vector<TileDescriptor> * regularTiles(void);
-	// vector<TileDescriptor> * groupByHostname(vector<TileDescriptor> * tls);
+
+	/**
+	 * @brief Enables node-compact placement
+	 * @details Every node gets compact block of slots of regular mesh,
+	 * 			halo neighbors share node. Called on all ranks before
+	 * 			the first regularTiles.
+	 *
+	 * @param hostNumbers - hostNumber of every rank
+	 */
+	void setHosts(const vector<int> & hostNumbers)	{ hosts = hostNumbers; slots.clear(); }
+
+	/**
+	 * @brief Rank owning slot of regular mesh
+	 */
+	int rankAt(unsigned slot) const	{ return slot < slots.size() ? slots[slot] : slot; }
+
+	/**
+	 * @brief Row neighbors of rank, MPI_PROC_NULL at domain edge
+	 * @details Row layouts keep order of slots within row,
+	 * 			valid after the first regularTiles.
+	 */
+	int leftOf(int rank) const;
+	int rightOf(int rank) const;
+
+	/**
+	 * @brief Column neighbors of rank and its row of slots,
+	 * 		  MPI_PROC_NULL at domain edge
+	 * @details Row layouts keep slots in rows, rank stays in its row
+	 * 			of tiles, valid after the first regularTiles.
+	 */
+	int aboveOf(int rank) const;
+	int belowOf(int rank) const;
+	unsigned rowOf(int rank) const	{ return slotOf[rank] / cols; }
+
+	/**
+	 * @brief Tiles ordered by slots of regular mesh (row-major)
+	 * @param tiles - tiles ordered by rank
+	 */
+	vector<TileDescriptor> inSlots(const vector<TileDescriptor> & tiles);
+
+	/**
+	 * @brief Node index of every tile, nodes are numbered by first rank
+	 * 		  with given hostNumber
+	 */
+	vector<int> nodesOf(const vector<TileDescriptor> & tiles);
+
+	/**
+	 * @brief True if aggregate node loads are within threshold
+	 * @details Time of node is work of its tiles divided by summed
+	 * 			performance of its ranks.
+	 *
+	 * @param perf - performance of every rank
+	 * @param work - work of actual tile of every rank
+	 * @param node - node of every rank (nodesOf)
+	 */
+	bool nodesBalanced(const vector<double> & perf, const vector<double> & work, const vector<int> & node);
+
+	/**
+	 * @brief Two level split of line of objects, nodes first, then ranks of node
+	 *
+	 * @details Consecutive parts of the same node form segment. Segments
+	 * 			are split by summed performance, unless keep is set, then
+	 * 			segments keep their actual size and objects move only
+	 * 			between parts of the same node.
+	 *
+	 * @param perf - performance of every part
+	 * @param node - node of every part, parts of node should be consecutive
+	 * @param current - actual size of every part in objects
+	 * @param line - cost of every object on the line
+	 * @param keep - segments keep actual size
+	 */
+	vector<unsigned> splitByNode(const vector<double> & perf, const vector<int> & node,
+								 const vector<unsigned> & current, const vector<double> & line, bool keep);
 
 	/**
 	 * @brief Migrate data between CPU using Zoltan_Migrate
@@ -110,6 +266,65 @@ public:
 
 	bool isBalanced( vector<double> & times);
 
+	/**
+	 * @brief Hysteresis of imbalance detection, called by root once per period
+	 *
+	 * @details Partition is computed only if imbalance persists for
+	 * 			hysteresis periods. Regular layout is restored only if
+	 * 			times predicted on regular tiles stay within lower band
+	 * 			(half of threshold) for hysteresis periods, balanced
+	 * 			times of balanced layout do not cause return to regular.
+	 *
+	 * @param times - estimated time of every rank
+	 * @param tiles - actual tiles
+	 * @return TBalancing
+	 */
+	int decide(vector<double> & times, const vector<TileDescriptor> & tiles);
+
+	/**
+	 * @brief Predicted iteration time of the slowest rank on new tiles
+	 * @details Rank keeps work done per second measured on actual tile.
+	 *
+	 * @param times - measured time of every rank
+	 * @param tiles - actual tiles ordered by rank
+	 * @param newTiles - new tiles ordered by rank
+	 * @param costs - sampled object costs, equal costs if empty
+	 */
+	double predictMax(const vector<double> & times, const vector<TileDescriptor> & tiles,
+					  const vector<TileDescriptor> & newTiles, const vector<double> & costs);
+
+	/**
+	 * @brief Number of objects changing owner between layouts
+	 */
+	unsigned movedObjects(const vector<TileDescriptor> & tiles, const vector<TileDescriptor> & newTiles);
+
+	/**
+	 * @brief True if tiles are ordered by rank and form rows of regular mesh,
+	 * 		  (widths, 2D and diffusion layouts)
+	 */
+	bool isRowLayout(const vector<TileDescriptor> & tiles);
+
+	/**
+	 * @brief Layout between two row layouts
+	 * @details Edges of rows and tiles are interpolated and rounded
+	 * 			to objects, order of edges is kept.
+	 *
+	 * @param f - 0 gives from, 1 gives to
+	 */
+	vector<TileDescriptor> * interpolate(const vector<TileDescriptor> & from,
+										 const vector<TileDescriptor> & to, double f);
+
+	/**
+	 * @brief Next layout of incremental migration from row layout to row layout
+	 * @details The furthest interpolated layout moving at most budget objects,
+	 * 			the smallest possible step if budget is lower than that.
+	 *
+	 * @param budget - objects moved by single step
+	 * @param last - set to true if to is reached
+	 */
+	vector<TileDescriptor> * budgetStep(const vector<TileDescriptor> & from,
+										const vector<TileDescriptor> & to, unsigned budget, bool & last);
+
 	// void setZoltanParts(const vector<float> & times);
 
 
@@ -150,6 +365,36 @@ protected:
 	unsigned objCols, objRows;
 	double threshold;
 
+	// repartitioning strategy (TStrategy)
+	int strategy;
+
+	// periods imbalance has to persist, see decide()
+	unsigned hysteresis;
+
+	// work is shifted between nodes only if node loads are imbalanced,
+	// widths and 2D strategies
+	bool nodeAware;
+
+	// hostNumber of every rank, empty - row-major placement
+	vector<int> hosts;
+
+	// rank of every slot of regular mesh, rows of tiles are formed by slots
+	vector<int> slots;
+
+	// slot of every rank, inverse of slots
+	vector<unsigned> slotOf;
+
+	// assigns blocks of slots to nodes
+	void placeSlots(void);
+	unsigned imbalancedPeriods;
+	unsigned regularPeriods;
+
+	// summed cost of rectangle of objects <x, x + w) x <y, y + h)
+	double costOf(const vector<double> & costs, unsigned x, unsigned y, unsigned w, unsigned h);
+
+	// summed cost of objects of tile
+	double costOf(const vector<double> & costs, const TileDescriptor & t);
+
 
 
 	
@@ -18,6 +18,8 @@
 
 #include <mpi.h>
 
+#include <Dims.h>
+
 namespace DLB {
 
 
@@ -48,6 +50,11 @@ public:
 		comm = MPI_COMM_NULL;
 		count = 0;
 		displ= 0;
+		sendCount = 0;
+		sendDispl = 0;
+		putDispl = 0;
+
+		sendType = recvType = MPI_DATATYPE_NULL;
 
 		scatterCnts = NULL;
 		scatterDispls = NULL;
@@ -74,6 +81,9 @@ public:
 		comm = MPI_COMM_NULL;
 		count = 0;
 		displ= 0;
+		sendCount = 0;
+		sendDispl = 0;
+		putDispl = 0;
 
 		if(scatterCnts != NULL){
 			delete[] scatterCnts;
@@ -95,8 +105,19 @@ public:
 
 	int myRank; 		//myRank in his communicator
 
-	unsigned count; 	// count of items which I share with him
-	unsigned displ;	// displacement in my buffer
+	unsigned count; 	// count of items which I receive from him
+	unsigned displ;	// displacement in my receive buffer
+
+	unsigned sendCount;	// count of items which I send to him
+	unsigned sendDispl;	// displacement in my send buffer
+	unsigned putDispl;	// displacement of my points in his receive buffer (EXCHANGE_RMA)
+
+	// halo rectangles, relative to my block including halo zones
+	Dims recvPos, recvSize;	// his points in my halo zone
+	Dims sendPos, sendSize;	// my points in his halo zone
+
+	// subarray datatypes of halo rectangles (EXCHANGE_DATATYPE only)
+	MPI_Datatype sendType, recvType;
 
 	// valus passed directly to Iscatterv
 	// aray of comm_size(comm)
@@ -22,6 +22,7 @@
 #include <stdexcept>
 #include <numeric>
 #include <cmath>
+#include <algorithm>
 
 #include <chrono>
 #include <thread>
@@ -34,7 +35,20 @@ using std::vector;
 
 namespace DLB {
 
-typedef enum method {AVERAGE } AGR_METHOD;
+/**
+ * Estimator of iteration time from history of actual period
+ *
+ * AVERAGE - arithmetic mean
+ * EWMA    - exponentially weighted moving average, recent iterations
+ *           have higher weight (EWMA_ALPHA)
+ * MEDIAN  - mean of iterations within MEDIAN_REJECT median absolute
+ *           deviations from median, rejects OS noise and I/O spikes
+ * TREND   - least squares line extrapolated to the middle of next period
+ */
+typedef enum method {AVERAGE = 0, EWMA, MEDIAN, TREND } AGR_METHOD;
+
+const double EWMA_ALPHA = 0.25;
+const double MEDIAN_REJECT = 3.0;
 
 /**
  * @brief Class for process performance measurement
@@ -58,6 +72,13 @@ public:
     unsigned sleepTotal;
     double last;
 
+    // halo exchange, comm - from start to completion
+    // wait - blocked in wait for completion
+    double comm;
+    double wait;
+    double commTotal;
+    double waitTotal;
+
     bool once;
     bool onceMult;
 
@@ -89,21 +110,27 @@ public:
     int rank;
     int worldSize;
 
+    // estimator used by getAgreg (AGR_METHOD)
+    int estimator;
+
     
-    PerfMeasure(int rank, int worldSize, unsigned period = 10):
+    PerfMeasure(int rank, int worldSize, unsigned period = 10, int estimator = AVERAGE):
     balance(0.0),
     iterTotal(0.0),
     iterAvg(0.0),
     ioTotal(0.0),
     balTotal(0.0),
     sleepTotal(0.0),
+    commTotal(0.0),
+    waitTotal(0.0),
     once(true),
     onceMult(true),
     period(period),
     iterCounter(0),
     periodEl(false),
     rank(rank),
-    worldSize(worldSize)
+    worldSize(worldSize),
+    estimator(estimator)
     {
 
     }
@@ -168,6 +195,36 @@ public:
         balTotal += balance;
     }
 
+    void commStart(void)
+    {
+        comm = MPI_Wtime();
+    }
+
+    void waitStart(void)
+    {
+        wait = MPI_Wtime();
+    }
+
+    /**
+     * @brief Stops wait timer, exchange is completed
+     */
+    void waitStop(void)
+    {
+        double now = MPI_Wtime();
+
+        wait = now - wait;
+        waitTotal += wait;
+        commTotal += now - comm;
+    }
+
+    /**
+     * @brief Fraction of exchange time hidden behind computation
+     */
+    double overlap(void) const
+    {
+        return commTotal > 0.0 ? 1.0 - waitTotal / commTotal : 0.0;
+    }
+
     double total(void) const
     {
         return io + balance + iter;
@@ -250,7 +307,7 @@ public:
 
     double getAgreg(void)
     {
-        return agregate(AVERAGE);
+        return agregate((AGR_METHOD) estimator);
     }
     
     double agregate(AGR_METHOD meth) const
@@ -265,11 +322,62 @@ public:
 
             result = accumulate(history.begin(), history.end(), 0.0) / history.size();
 
+        }else if(meth == EWMA){
+
+            result = history.front();
+
+            for(auto t : history)
+                result = EWMA_ALPHA * t + (1.0 - EWMA_ALPHA) * result;
+
+        }else if(meth == MEDIAN){
+
+            vector<double> dev;
+            double med = median(history);
+
+            for(auto t : history)
+                dev.push_back(std::fabs(t - med));
+
+            double mad = median(dev);
+            unsigned cnt = 0;
+
+            for(auto t : history){
+                if(std::fabs(t - med) <= MEDIAN_REJECT * mad){
+                    result += t;
+                    cnt++;
+                }
+            }
+
+            result = cnt > 0 ? result / cnt : med;
+
+        }else if(meth == TREND){
+
+            double n = history.size();
+            double mx = (n - 1.0) / 2.0;
+            double my = accumulate(history.begin(), history.end(), 0.0) / n;
+            double sxy = 0.0, sxx = 0.0;
+
+            for(unsigned i = 0; i < history.size(); i++){
+                sxy += (i - mx) * (history[i] - my);
+                sxx += (i - mx) * (i - mx);
+            }
+
+            double slope = sxx > 0.0 ? sxy / sxx : 0.0;
+
+            // middle of next period, never below fastest measured iteration
+            result = my + slope * (n - 1.0 + period / 2.0 - mx);
+            result = std::max(result, *std::min_element(history.begin(), history.end()));
         }
 
         return result;
     }
 
+    static double median(vector<double> v)
+    {
+        std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+
+        return v[v.size() / 2];
+    }
+
     void reset(void)
     {
         periodEl = false;
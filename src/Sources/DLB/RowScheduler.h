@@ -0,0 +1,178 @@
+/***********************************************
+*
+*  File Name:       RowScheduler.h
+*
+*  Project:         Dynamic Load Balancing in HPC Applications
+*                   DIP (SC@FIT)
+*
+*  Description:     Work stealing of row chunks between
+*                   threads of single rank
+*
+***********************************************/
+
+#ifndef __DLB_ROW_SCHEDULER_H__
+#define __DLB_ROW_SCHEDULER_H__
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace DLB {
+
+
+/**
+ * @brief Intra rank balancing of rows between threads
+ *
+ * @details Region is split into chunks of rows, every thread owns
+ *          contiguous band of chunks (same as static schedule, so
+ *          first touch locality is kept). Owner takes chunks from
+ *          the front of its band, thread with empty band steals
+ *          chunks from the back of other bands. Short imbalance
+ *          (OS noise, SMT) is absorbed locally, without migration.
+ *
+ *          Band is packed into single 64 bit word (front << 32 | back),
+ *          both owner and thieves update it by compare and swap.
+ */
+
+class RowScheduler {
+
+public:
+
+	/**
+	 * @param chunkRows - rows in one chunk, unit of stealing
+	 */
+	RowScheduler(unsigned chunkRows = 4):
+	chunkRows(std::max(1u, chunkRows)),
+	steals(0)
+	{}
+
+	/**
+	 * @brief Calls f(rowBegin, rowEnd) for all chunks of <top, bottom)
+	 * @details Must be called outside of parallel region,
+	 * 			every row is passed exactly once.
+	 */
+	template <class F>
+	void run(int top, int bottom, F f)
+	{
+		if(top >= bottom)
+			return;
+
+#ifdef _OPENMP
+		unsigned chunks = (bottom - top + chunkRows - 1) / chunkRows;
+		unsigned threads = std::min<unsigned>(omp_get_max_threads(), chunks);
+
+		if(threads > 1){
+
+			resize(threads);
+
+			#pragma omp parallel num_threads(threads)
+			{
+				unsigned tid = omp_get_thread_num();
+				unsigned nth = omp_get_num_threads();
+
+				// static bands of chunks
+				uint64_t front = (uint64_t) chunks * tid / nth;
+				uint64_t back = (uint64_t) chunks * (tid + 1) / nth;
+
+				bands[tid].value.store((front << 32) | back);
+
+				#pragma omp barrier
+
+				unsigned chunk;
+
+				while(take(tid, chunk))
+					f(top + chunk * chunkRows, std::min<int>(top + (chunk + 1) * chunkRows, bottom));
+
+				for(unsigned i = 1; i < nth; i++){
+
+					unsigned victim = (tid + i) % nth;
+
+					while(steal(victim, chunk)){
+
+						steals++;
+						f(top + chunk * chunkRows, std::min<int>(top + (chunk + 1) * chunkRows, bottom));
+					}
+				}
+			}
+
+			return;
+		}
+#endif
+
+		f(top, bottom);
+	}
+
+	/**
+	 * @brief Number of chunks computed by other than owning thread
+	 */
+	unsigned long getSteals(void) const	{ return steals.load(); }
+
+	unsigned getChunkRows(void) const	{ return chunkRows; }
+
+protected:
+
+	// band padded to cache line, avoids false sharing between owners
+	struct Band {
+		std::atomic<uint64_t> value;
+		char pad[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	void resize(unsigned threads)
+	{
+		if(bandCount < threads){
+			bands.reset(new Band[threads]);
+			bandCount = threads;
+		}
+	}
+
+	// owner takes chunk from the front of its band
+	bool take(unsigned tid, unsigned & chunk)
+	{
+		uint64_t v = bands[tid].value.load();
+
+		while((v >> 32) < (v & 0xffffffff)){
+
+			if(bands[tid].value.compare_exchange_weak(v, v + ((uint64_t) 1 << 32))){
+				chunk = v >> 32;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// thief takes chunk from the back of victim band
+	bool steal(unsigned victim, unsigned & chunk)
+	{
+		uint64_t v = bands[victim].value.load();
+
+		while((v >> 32) < (v & 0xffffffff)){
+
+			if(bands[victim].value.compare_exchange_weak(v, v - 1)){
+				chunk = (v & 0xffffffff) - 1;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	unsigned chunkRows;
+
+	std::unique_ptr<Band[]> bands;
+	unsigned bandCount = 0;
+
+	std::atomic<unsigned long> steals;
+
+};
+
+
+} //DLB nspace end
+
+#endif
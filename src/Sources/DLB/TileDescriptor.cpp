@@ -42,7 +42,7 @@ size(data.dimx, data.dimy),
 rank(data.rank),
 hostNumber(data.hostNumber)
 {
-    setHostNumber(getHostname());
+    // host of tile owner is received, not the local one
 }
 
 
@@ -170,10 +170,10 @@ unsigned TileDescriptor::getArea(void) const
     return size.x * size.y;
 }
 
-unsigned TileDescriptor::getExtArea(void) const
+unsigned TileDescriptor::getExtArea(int haloSize) const
 {
 
-    return (size.x + 2*HALO_WIDTH) * (size.y + 2*HALO_WIDTH);
+    return (size.x + 2*haloSize) * (size.y + 2*haloSize);
 
 }
 
@@ -403,6 +403,60 @@ unsigned TileDescriptor::getOverlapOffset(const TileDescriptor & tile, unsigned
 
 }
 
+/**
+ * @brief Computes part of given tile covered by halo zone of this tile
+ * @details Halo zone is a frame of haloSize points around this tile.
+ *             Without corners, only the parts of the frame adjacent to tile
+ *             edges are used (cross shape), which is sufficient for single
+ *             step exchange. Multi-step exchange needs corners as well.
+ * 
+ * @param tile - other tile
+ * @param haloSize - width of halo zone
+ * @param corners - include halo zone corners
+ * @param pos - absolute position of overlap
+ * @param size - size of overlap
+ * @return true if tile overlaps halo zone
+ */
+bool TileDescriptor::getHaloOverlap(const TileDescriptor & tile, unsigned haloSize, bool corners,
+                                    Dims & pos, Dims & size) const
+{
+    int h = haloSize;
+    Dims tpos = tile.getPosition();
+    Dims tsize = tile.getSize();
+
+    // tile without points has no halo zone and covers none,
+    // relation stays symmetric
+    if(tsize.x * tsize.y == 0 || this->size.x * this->size.y == 0)
+        return false;
+
+    // intersection of tile with this tile extended by halo zone
+    int x0 = std::max<int>(tpos.x, (int) position.x - h);
+    int x1 = std::min<int>(tpos.x + tsize.x, position.x + this->size.x + h);
+    int y0 = std::max<int>(tpos.y, (int) position.y - h);
+    int y1 = std::min<int>(tpos.y + tsize.y, position.y + this->size.y + h);
+
+    if(!corners){
+
+        if(x1 <= (int) position.x || x0 >= (int) (position.x + this->size.x)){
+            // left or right of this tile
+            y0 = std::max<int>(y0, position.y);
+            y1 = std::min<int>(y1, position.y + this->size.y);
+        }else{
+            // above or below this tile
+            x0 = std::max<int>(x0, position.x);
+            x1 = std::min<int>(x1, position.x + this->size.x);
+        }
+    }
+
+    if(x0 >= x1 || y0 >= y1)
+        return false;
+
+    pos = Dims(x0, y0);
+    size = Dims(x1 - x0, y1 - y0);
+
+    return true;
+}
+
 /**
  * @brief Standard UNIX gethostname() wrapper
  * @return hostname or throws runtime_error
@@ -410,11 +464,12 @@ unsigned TileDescriptor::getOverlapOffset(const TileDescriptor & tile, unsigned
 
 string TileDescriptor::getHostname(void)
 {
-    const int STRING_SIZE = 50;
+    const int STRING_SIZE = 256;
 
-    char temp[STRING_SIZE];
+    // terminating zero is kept even if hostname is truncated
+    char temp[STRING_SIZE + 1];
     
-    for(int i = 0; i < STRING_SIZE; i++){
+    for(int i = 0; i <= STRING_SIZE; i++){
         temp[i] = 0;
     }
 
@@ -423,7 +478,7 @@ string TileDescriptor::getHostname(void)
 
     if(err){
         stringstream ss;
-        ss << "TopologyDescriptor::getHostname - hostname resolution failed, errno = " << err << endl;
+        ss << "TopologyDescriptor::getHostname - hostname resolution failed, errno = " << errno << endl;
         throw std::runtime_error(ss.str()) ;
 
     }
@@ -440,8 +495,7 @@ string TileDescriptor::getHostname(void)
 
 /**
  * @brief Resolves integer hostname identifier from hostname
- * @details ID is constructe as all decimal numbers in hostname.
- *             Not general, you're welcome to reimplement.
+ * @details ID is hash of hostname, the same on all ranks of node.
  * 
  * @param hostname [description]
  * @return host ID
@@ -22,6 +22,8 @@
 #include <unistd.h>
 #include <functional>
 #include <cstring>
+#include <cerrno>
+#include <algorithm>
 
 #include <Dims.h>
 #include <TileMsg.h>
@@ -79,8 +81,8 @@ public:
     // width * height
     unsigned getArea(void) const;
 
-    unsigned getExtArea(void) const;
-    Dims getExtSize(int haloSize = 2) const;
+    unsigned getExtArea(int haloSize = HALO_WIDTH) const;
+    Dims getExtSize(int haloSize = HALO_WIDTH) const;
 
     bool isMiddle(unsigned mid);
 
@@ -97,6 +99,8 @@ public:
     bool isNeighbor(const TileDescriptor & tile) const;
     TEdge getSharedEdge(const TileDescriptor & tile) const;
     unsigned getOverlapOffset(const TileDescriptor & tile,  unsigned & cnt) const;
+    bool getHaloOverlap(const TileDescriptor & tile, unsigned haloSize, bool corners,
+                        Dims & pos, Dims & size) const;
 
 
     void setHostNumber(int hostNumber) {this->hostNumber = hostNumber; }
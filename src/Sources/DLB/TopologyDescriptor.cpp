@@ -22,10 +22,14 @@ using Dims = DLB::Dims;
 using TEdge = DLB::TileDescriptor::TEdge;
 
 
-TopologyDescriptor::TopologyDescriptor(int rank, int worldSize, size_t edgeSize):
+TopologyDescriptor::TopologyDescriptor(int rank, int worldSize, size_t edgeSize, unsigned haloSize,
+                                       int exchange):
 rank(rank),
 worldSize(worldSize),
-edgeSize(edgeSize)
+edgeSize(edgeSize),
+haloSize(haloSize),
+haloCorners(haloSize > HALO_WIDTH),
+exchange(exchange)
 {
     topologyChanged = false;
 
@@ -41,11 +45,18 @@ edgeSize(edgeSize)
      initDtypes(); 
 
      myComm = MPI_COMM_NULL;
+     graphComm = MPI_COMM_NULL;
 }
 
 TopologyDescriptor::~TopologyDescriptor(void)
 {
-    MPI_assert( MPI_Comm_free(&myComm) LOCATION);
+    if(myComm != MPI_COMM_NULL)
+        MPI_assert( MPI_Comm_free(&myComm) LOCATION);
+
+    if(graphComm != MPI_COMM_NULL)
+        MPI_assert( MPI_Comm_free(&graphComm) LOCATION);
+
+    freeHaloTypes();
 }
 
 
@@ -143,16 +154,33 @@ void TopologyDescriptor::updateTopology(void)
     if(myComm != MPI_COMM_NULL)
         MPI_Comm_free(&myComm);
 
+    if(graphComm != MPI_COMM_NULL)
+        MPI_Comm_free(&graphComm);
+
+    freeHaloTypes();
     nData.clear();
 
     neighbors.clear();
     displs.clear(); 
     counts.clear();
 
+    nbrSendCounts.clear();
+    nbrSendDispls.clear();
+    nbrRecvCounts.clear();
+    nbrRecvDispls.clear();
+
     // order must be preserved
     countNeighborRanks();
     countDispls();
-    initComms(); //dependent on neighbors
+
+    //dependent on neighbors
+    if(exchange == EXCHANGE_NEIGHBOR)
+        initGraphComm();
+    else if(exchange == EXCHANGE_SCATTER)
+        initComms(); 
+    else if(exchange == EXCHANGE_DATATYPE)
+        initHaloTypes();
+
     midUpdate();
 
 
@@ -168,11 +196,14 @@ void TopologyDescriptor::updateTopology(void)
  */
 void TopologyDescriptor::countNeighborRanks(void)
 {
+    Dims pos, size;
+
     neighbors.clear();
 
+    // relation is symmetric, t covers my halo zone iff I cover his
     for(auto t : tiles){
 
-        if( myTile != t && myTile.isNeighbor(t) )        
+        if( myTile != t && myTile.getHaloOverlap(t, haloSize, haloCorners, pos, size) )        
             neighbors.push_back(t.getRank());
 
     }
@@ -180,55 +211,75 @@ void TopologyDescriptor::countNeighborRanks(void)
     sort(neighbors.begin(), neighbors.end());
 }
 
+/**
+ * @brief Computes halo rectangles, counts and displacements
+ * @details Both send and receive buffers are ordered by neighbor rank,
+ *          every rectangle is stored row by row.
+ */
 void TopologyDescriptor::countDispls(void)
 {
-	unsigned cnt;
-    Neighbor nbor;
+    Dims pos, size;
+    Dims origin = myTile.getPosition();
+    unsigned recvDsp = 0, sendDsp = 0;
 
 	for(auto n: neighbors){
+
+        Neighbor nbor;
+
 		// find neighbor interator by rank
 	    auto res = find(tiles.begin(), tiles.end(), n);
-	    // get neighbor index
-	    unsigned idx = res - tiles.begin();
-        unsigned dsp = myTile.getOverlapOffset(tiles[idx], cnt);
 
-        nbor.displ = 2*dsp;
-        nbor.count = 2*cnt;
+        // his points in my halo zone
+        myTile.getHaloOverlap(*res, haloSize, haloCorners, pos, size);
+        nbor.recvPos = Dims(pos.x - origin.x + haloSize, pos.y - origin.y + haloSize);
+        nbor.recvSize = size;
+        nbor.displ = recvDsp;
+        nbor.count = size.x * size.y;
+
+        // my points in his halo zone
+        res->getHaloOverlap(myTile, haloSize, haloCorners, pos, size);
+        nbor.sendPos = Dims(pos.x - origin.x + haloSize, pos.y - origin.y + haloSize);
+        nbor.sendSize = size;
+        nbor.sendDispl = sendDsp;
+        nbor.sendCount = size.x * size.y;
+
+        // his receive buffer is ordered by rank of his neighbors as well
+        if(exchange == EXCHANGE_RMA){
+
+            for(auto & t : tiles){
+
+                if(t.getRank() >= rank)
+                    break;
+
+                if(t != *res && res->getHaloOverlap(t, haloSize, haloCorners, pos, size))
+                    nbor.putDispl += size.x * size.y;
+            }
+        }
+
         nbor.wRank = n;
 
-        displs.push_back(2*dsp);
-        counts.push_back(2*cnt);
+        recvDsp += nbor.count;
+        sendDsp += nbor.sendCount;
+
+        displs.push_back(nbor.sendDispl);
+        counts.push_back(nbor.sendCount);
+
+        nbrSendCounts.push_back(nbor.sendCount);
+        nbrSendDispls.push_back(nbor.sendDispl);
+        nbrRecvCounts.push_back(nbor.count);
+        nbrRecvDispls.push_back(nbor.displ);
 
         nData.insert(pair<int, Neighbor>(n, nbor ));
-        // nbor.clear();
 
 	}
 
     // insert counts and dipls for scatter for this tile
-    // must be put to appropriate place relative to neighbors
-    bool once = true;
-    for(auto it = neighbors.begin(); it < neighbors.end();it++){
-
-        if(once && (*neighbors.begin()) > rank){
-
-            counts.insert(counts.begin(), 0);
-            displs.insert(displs.begin(), 0);
-            once = false;
-            
-        }else if(once &&  *(neighbors.end() - 1) < rank){
-
-            counts.insert(counts.end(), 0);
-            displs.insert(displs.end(), 0);
-            once = false;
-
-        }else if(once &&  (*it < rank) && ((it+1) != neighbors.end()) && (*(it+ 1) > rank) )
-        {   //somewhere inside
-            unsigned idx = it - neighbors.begin();
-            counts.insert(counts.begin() + idx +1, 0);
-            displs.insert(displs.begin() + idx +1, 0);
-            once = false;
-        }
-    }
+    // must be put to appropriate place relative to neighbors,
+    // tile without neighbors (eg. of zero area) scatters to itself only
+    unsigned idx = std::lower_bound(neighbors.begin(), neighbors.end(), rank) - neighbors.begin();
+
+    counts.insert(counts.begin() + idx, 0);
+    displs.insert(displs.begin() + idx, 0);
 }
 
 
@@ -337,6 +388,60 @@ void TopologyDescriptor::initComms(void)
 }
 
 
+void TopologyDescriptor::initGraphComm(void)
+{
+    // neighborhood is symmetric, sources == destinations
+    MPI_assert( MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+                                               neighbors.size(), neighbors.data(), MPI_UNWEIGHTED,
+                                               neighbors.size(), neighbors.data(), MPI_UNWEIGHTED,
+                                               MPI_INFO_NULL, 0, &graphComm),
+                "Dist_graph_create_adjacent failed" LOCATION);
+
+    MPI_assert( MPI_Comm_set_name(graphComm, "Comm graph"), "Set comm name err" LOCATION);
+
+    for(auto n : neighbors)
+        nData.at(n).wRank = n;
+}
+
+
+void TopologyDescriptor::initHaloTypes(void)
+{
+    Dims ext = myTile.getExtSize(haloSize);
+    int sizes[2] = {(int) ext.y, (int) ext.x};
+
+    for(auto n : neighbors){
+
+        Neighbor & nb = nData.at(n);
+
+        int ssub[2] = {(int) nb.sendSize.y, (int) nb.sendSize.x};
+        int sstart[2] = {(int) nb.sendPos.y, (int) nb.sendPos.x};
+        int rsub[2] = {(int) nb.recvSize.y, (int) nb.recvSize.x};
+        int rstart[2] = {(int) nb.recvPos.y, (int) nb.recvPos.x};
+
+        MPI_assert( MPI_Type_create_subarray(2, sizes, ssub, sstart, MPI_ORDER_C, MPI_FLOAT, &nb.sendType),
+                    "Create subarray failed" LOCATION);
+        MPI_assert( MPI_Type_create_subarray(2, sizes, rsub, rstart, MPI_ORDER_C, MPI_FLOAT, &nb.recvType),
+                    "Create subarray failed" LOCATION);
+
+        MPI_assert( MPI_Type_commit(&nb.sendType), "Type commit failed" LOCATION);
+        MPI_assert( MPI_Type_commit(&nb.recvType), "Type commit failed" LOCATION);
+    }
+}
+
+void TopologyDescriptor::freeHaloTypes(void)
+{
+    for(auto & n : nData){
+
+        MPI_Datatype * types[2] = {&n.second.sendType, &n.second.recvType};
+
+        for(auto t : types){
+            if(*t != MPI_DATATYPE_NULL)
+                MPI_assert( MPI_Type_free(t), "Type free failed" LOCATION);
+        }
+    }
+}
+
+
 string TopologyDescriptor::toString(void)
 {
     stringstream ss;
@@ -449,24 +554,24 @@ void TopologyDescriptor::getBorders(BlockData & bd)
 {
     Dims s = myTile.getSize();
 
-	bd.top = 2;
-    bd.right = s.x + 2;
-    bd.bottom = s.y + 2;
-    bd.left = 2;
+	bd.top = haloSize;
+    bd.right = s.x + haloSize;
+    bd.bottom = s.y + haloSize;
+    bd.left = haloSize;
 
     // set initial
     
   	if(borders[TEdge::TOP]){
-  		bd.top = 4;
+  		bd.top = haloSize + 2;
    	}
    	if(borders[TEdge::RIGHT]){
-        bd.right = s.x;
+        bd.right = s.x + haloSize - 2;
    	}
    	if(borders[TEdge::BOTTOM]){
-        bd.bottom = s.y;
+        bd.bottom = s.y + haloSize - 2;
    	}
    	if(borders[TEdge::LEFT]){
-        bd.left = 4;
+        bd.left = haloSize + 2;
    	}
 
     // flag for computing halos
@@ -495,6 +600,12 @@ DLB::BlockData TopologyDescriptor::getBlockData(void)
 
     bd.myComm = myComm;
     bd.myCommRank = myCommRank;
+
+    bd.graphComm = graphComm;
+    bd.nbrSendCounts = &nbrSendCounts;
+    bd.nbrSendDispls = &nbrSendDispls;
+    bd.nbrRecvCounts = &nbrRecvCounts;
+    bd.nbrRecvDispls = &nbrRecvDispls;
     
 
     //middle communicator
@@ -506,6 +617,18 @@ DLB::BlockData TopologyDescriptor::getBlockData(void)
     return bd;
 }
 
+unsigned TopologyDescriptor::getHaloLen(void) const
+{
+    unsigned send = 0, recv = 0;
+
+    for(auto & n : nData){
+        send += n.second.sendCount;
+        recv += n.second.count;
+    }
+
+    return std::max(send, recv);
+}
+
 void TopologyDescriptor::setTile(const TileDescriptor & t)
 {
     myTile = t;
@@ -40,6 +40,26 @@ using std::pair;
 namespace DLB {
 
 
+/**
+ * @brief Halo exchange backend
+ * 
+ * EXCHANGE_SCATTER    - Iscatterv on communicator per neighbor (Comm_split per rank)
+ * EXCHANGE_NEIGHBOR   - Ineighbor_alltoallv on distributed graph communicator
+ * EXCHANGE_PERSISTENT - persistent point to point requests, no communicators
+ * EXCHANGE_DATATYPE   - as EXCHANGE_PERSISTENT, halo rectangles are described
+ *                       by subarray datatypes, no packing
+ * EXCHANGE_SHARED     - neighbors on the same node read packed halo zones
+ *                       from MPI-3 shared window, persistent point to point
+ *                       requests to other nodes
+ * EXCHANGE_RMA        - receive buffer is exposed in MPI window, neighbors put
+ *                       their rectangles into it, PSCW synchronization
+ *                       within neighbor group
+ * EXCHANGE_AUTO       - backend is chosen at startup by benchmark
+ *                       of all the others, see HaloExchanger::create
+ */
+typedef enum exchange { EXCHANGE_AUTO = -1, EXCHANGE_SCATTER = 0, EXCHANGE_NEIGHBOR, EXCHANGE_PERSISTENT,
+                        EXCHANGE_DATATYPE, EXCHANGE_SHARED, EXCHANGE_RMA } TExchange;
+
 
 /**
  * @brief Describes topology of problem domain, holds metadata of all
@@ -54,7 +74,14 @@ class TopologyDescriptor {
 
 public:
 
-	TopologyDescriptor(int rank, int worldSize, size_t edgeSize);	
+	/**
+	 * @param haloSize - width of halo zones, halo zone corners
+	 * 					 are exchanged when wider than HALO_WIDTH
+	 * @param exchange - halo exchange backend (TExchange), only
+	 * 					 communicators of given backend are created
+	 */
+	TopologyDescriptor(int rank, int worldSize, size_t edgeSize, unsigned haloSize = HALO_WIDTH,
+					   int exchange = EXCHANGE_SCATTER);
 
 
 	~TopologyDescriptor(void);
@@ -98,6 +125,21 @@ public:
 
 	vector<TileDescriptor> & getTiles(void);
 
+	unsigned getHaloSize(void) const { return haloSize; }
+
+	int getExchange(void) const { return exchange; }
+
+	/**
+	 * @brief Sets halo exchange backend, communicators
+	 * 		  are created by next updateTopology()
+	 */
+	void setExchange(int exchange) { this->exchange = exchange; }
+
+	/**
+	 * @brief Buffer length sufficient for both sent and received halo zones
+	 */
+	unsigned getHaloLen(void) const;
+
 
 	/**
  	* @brief Updates all topology related metadata 
@@ -149,6 +191,22 @@ protected:
 	
 	void initComms(void);
 
+	/**
+	 * @brief Initialize distributed graph communicator
+	 * @detailed Single MPI_Dist_graph_create_adjacent call, every
+	 * 		tile passes its neighbors only. Neighbor order in graph
+	 * 		communicator is the order of neighbors vector.
+	 */
+	void initGraphComm(void);
+
+	/**
+	 * @brief Creates subarray datatypes of halo rectangles for all neighbors
+	 * @detailed Types describe rectangles inside block including
+	 * 		halo zones, they are cached in nData until topology changes.
+	 */
+	void initHaloTypes(void);
+	void freeHaloTypes(void);
+
 	/**
 	 * @brief Initialize TileMsg as MPI datatype
 	 */
@@ -156,8 +214,8 @@ protected:
 	void initDtypes(void);
     /**
      * @brief Set block data border for halo zone
-     *        2 - standard halo zone
-     *        4 - edge shared with domain edge -> no halo zone
+     *        haloSize - standard halo zone
+     *        haloSize + 2 - edge shared with domain edge -> no halo zone
      *        
      * 
      * @param BlockData beeing generated
@@ -199,9 +257,22 @@ protected:
   	// sorted in order of neighbors 
   	vector<int>  counts;
 
+  	// graph communicator and Ineighbor_alltoallv arguments
+  	// sorted in order of neighbors, without this tile
+  	MPI_Comm graphComm;
+  	vector<int> nbrSendCounts, nbrSendDispls;
+  	vector<int> nbrRecvCounts, nbrRecvDispls;
+
 	int rank, worldSize; //in COMM_WORLD
 	size_t edgeSize;
 
+	// halo zone width, corners are needed for multi-step exchange
+	unsigned haloSize;
+	bool haloCorners;
+
+	// halo exchange backend (TExchange)
+	int exchange;
+
 	 // optional middle
   	bool middle;
   	MPI_Comm COMM_MIDDLE;
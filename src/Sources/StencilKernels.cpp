@@ -0,0 +1,311 @@
+/**
+ * @file        StencilKernels.cpp
+ *
+ * @brief       Heat distribution stencil kernels
+ *
+ * @detail
+ * Vector width is chosen at compile time, the SIMD kernel itself
+ * is written once on top of small set of wrappers below.
+ */
+
+#include <immintrin.h>
+
+#include "StencilKernels.h"
+
+
+//----------------------------------------------------------------------------//
+//------------------------------ Vector wrappers -----------------------------//
+//----------------------------------------------------------------------------//
+
+namespace {
+
+#if defined(__AVX512F__)
+
+typedef __m512 vfloat;
+const size_t VLEN = 16;
+
+inline vfloat vload(const float * p)          { return _mm512_loadu_ps(p); }
+inline void   vstore(float * p, vfloat a)     { _mm512_storeu_ps(p, a); }
+inline vfloat vset(float a)                   { return _mm512_set1_ps(a); }
+inline vfloat vadd(vfloat a, vfloat b)        { return _mm512_add_ps(a, b); }
+inline vfloat vmul(vfloat a, vfloat b)        { return _mm512_mul_ps(a, b); }
+inline vfloat vdiv(vfloat a, vfloat b)        { return _mm512_div_ps(a, b); }
+inline vfloat vfma(vfloat a, vfloat b, vfloat c) { return _mm512_fmadd_ps(a, b, c); }
+
+// a where map == 0, b otherwise
+inline vfloat vselectAir(const int * map, vfloat a, vfloat b)
+{
+    const __mmask16 air = _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(map),
+                                                  _mm512_setzero_si512());
+    return _mm512_mask_blend_ps(air, b, a);
+}
+
+const char * SIMD_EXT = "AVX-512";
+
+#elif defined(__AVX__)
+
+typedef __m256 vfloat;
+const size_t VLEN = 8;
+
+inline vfloat vload(const float * p)          { return _mm256_loadu_ps(p); }
+inline void   vstore(float * p, vfloat a)     { _mm256_storeu_ps(p, a); }
+inline vfloat vset(float a)                   { return _mm256_set1_ps(a); }
+inline vfloat vadd(vfloat a, vfloat b)        { return _mm256_add_ps(a, b); }
+inline vfloat vmul(vfloat a, vfloat b)        { return _mm256_mul_ps(a, b); }
+inline vfloat vdiv(vfloat a, vfloat b)        { return _mm256_div_ps(a, b); }
+#ifdef __FMA__
+inline vfloat vfma(vfloat a, vfloat b, vfloat c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+inline vfloat vfma(vfloat a, vfloat b, vfloat c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+
+// a where map == 0, b otherwise (int -> float conversion is exact for 0)
+inline vfloat vselectAir(const int * map, vfloat a, vfloat b)
+{
+    const vfloat m   = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *) map));
+    const vfloat air = _mm256_cmp_ps(m, _mm256_setzero_ps(), _CMP_EQ_OQ);
+    return _mm256_blendv_ps(b, a, air);
+}
+
+#ifdef __AVX2__
+const char * SIMD_EXT = "AVX2";
+#else
+const char * SIMD_EXT = "AVX";
+#endif
+
+#else
+
+typedef __m128 vfloat;
+const size_t VLEN = 4;
+
+inline vfloat vload(const float * p)          { return _mm_loadu_ps(p); }
+inline void   vstore(float * p, vfloat a)     { _mm_storeu_ps(p, a); }
+inline vfloat vset(float a)                   { return _mm_set1_ps(a); }
+inline vfloat vadd(vfloat a, vfloat b)        { return _mm_add_ps(a, b); }
+inline vfloat vmul(vfloat a, vfloat b)        { return _mm_mul_ps(a, b); }
+inline vfloat vdiv(vfloat a, vfloat b)        { return _mm_div_ps(a, b); }
+inline vfloat vfma(vfloat a, vfloat b, vfloat c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+// a where map == 0, b otherwise
+inline vfloat vselectAir(const int * map, vfloat a, vfloat b)
+{
+    const vfloat air = _mm_castsi128_ps(
+                          _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) map),
+                                          _mm_setzero_si128()));
+    return _mm_or_ps(_mm_and_ps(air, a), _mm_andnot_ps(air, b));
+}
+
+const char * SIMD_EXT = "SSE2";
+
+#endif
+
+} // anonymous namespace
+
+
+//----------------------------------------------------------------------------//
+//------------------------------ Row kernels ---------------------------------//
+//----------------------------------------------------------------------------//
+
+void ComputeRowScalar(float  *oldTemp,
+                      float  *newTemp,
+                      float  *params,
+                      int    *map,
+                      size_t  i,
+                      size_t  jStart,
+                      size_t  jEnd,
+                      size_t  edgeSize,
+                      float   airFlowRate,
+                      float   coolerTemp)
+{
+    for(size_t j = jStart; j < jEnd; j++)
+        ComputePoint(oldTemp, newTemp, params, map, i, j,
+                     edgeSize, airFlowRate, coolerTemp);
+}
+
+
+void ComputeRowSimd(float  *oldTemp,
+                    float  *newTemp,
+                    float  *params,
+                    int    *map,
+                    size_t  i,
+                    size_t  jStart,
+                    size_t  jEnd,
+                    size_t  edgeSize,
+                    float   airFlowRate,
+                    float   coolerTemp)
+{
+    // row pointers, all indexed by column
+    const float * t0 = oldTemp + i * edgeSize;
+    const float * t1 = t0 - edgeSize;
+    const float * t2 = t0 - 2 * edgeSize;
+    const float * b1 = t0 + edgeSize;
+    const float * b2 = t0 + 2 * edgeSize;
+
+    const float * p0 = params + i * edgeSize;
+    const float * pt1 = p0 - edgeSize;
+    const float * pt2 = p0 - 2 * edgeSize;
+    const float * pb1 = p0 + edgeSize;
+    const float * pb2 = p0 + 2 * edgeSize;
+
+    const int * m0  = map + i * edgeSize;
+    float     * out = newTemp + i * edgeSize;
+
+    const vfloat one     = vset(1.0f);
+    const vfloat airPart = vset(airFlowRate * coolerTemp);
+    const vfloat keep    = vset(1.0f - airFlowRate);
+
+    size_t j = jStart;
+
+    for(; j + VLEN <= jEnd; j += VLEN){
+
+        // parameters, same order as in ComputePoint
+        const vfloat pT0 = vload(pt1 + j);
+        const vfloat pT1 = vload(pt2 + j);
+        const vfloat pB0 = vload(pb1 + j);
+        const vfloat pB1 = vload(pb2 + j);
+        const vfloat pL0 = vload(p0 + j - 1);
+        const vfloat pL1 = vload(p0 + j - 2);
+        const vfloat pR0 = vload(p0 + j + 1);
+        const vfloat pR1 = vload(p0 + j + 2);
+        const vfloat pC  = vload(p0 + j);
+
+        vfloat sum = vadd(pT0, pT1);
+        sum = vadd(sum, pB0);
+        sum = vadd(sum, pB1);
+        sum = vadd(sum, pL0);
+        sum = vadd(sum, pL1);
+        sum = vadd(sum, pR0);
+        sum = vadd(sum, pR1);
+        sum = vadd(sum, pC);
+
+        const vfloat frac = vdiv(one, sum);
+
+        vfloat pointTemp = vmul(vmul(vload(t1 + j), pT0), frac);
+        pointTemp = vadd(pointTemp, vmul(vmul(vload(t2 + j),     pT1), frac));
+        pointTemp = vadd(pointTemp, vmul(vmul(vload(b1 + j),     pB0), frac));
+        pointTemp = vadd(pointTemp, vmul(vmul(vload(b2 + j),     pB1), frac));
+        pointTemp = vadd(pointTemp, vmul(vmul(vload(t0 + j - 1), pL0), frac));
+        pointTemp = vadd(pointTemp, vmul(vmul(vload(t0 + j - 2), pL1), frac));
+        pointTemp = vadd(pointTemp, vmul(vmul(vload(t0 + j + 1), pR0), frac));
+        pointTemp = vadd(pointTemp, vmul(vmul(vload(t0 + j + 2), pR1), frac));
+        pointTemp = vadd(pointTemp, vmul(vmul(vload(t0 + j),     pC),  frac));
+
+        // air flow blend for map == 0
+        const vfloat cooled = vadd(airPart, vmul(keep, pointTemp));
+
+        vstore(out + j, vselectAir(m0 + j, cooled, pointTemp));
+    }
+
+    // remainder
+    ComputeRowScalar(oldTemp, newTemp, params, map, i, j, jEnd,
+                     edgeSize, airFlowRate, coolerTemp);
+}
+
+
+void BuildStencilWeights(const float *params,
+                         const int   *map,
+                         float       *weights,
+                         size_t       width,
+                         size_t       height,
+                         float        airFlowRate,
+                         float        coolerTemp)
+{
+    const long e = width;
+    // neighbor offsets in plane order
+    const long offsets[STENCIL_PLANES - 1] = { -e, -2*e, e, 2*e, -1, -2, 1, 2, 0 };
+
+    for(size_t i = 0; i < height; i++){
+
+        float * w = weights + i * STENCIL_PLANES * width;
+
+        for(size_t j = 0; j < width; j++){
+
+            // points without complete stencil are never computed
+            if(i < 2 || i + 2 >= height || j < 2 || j + 2 >= width){
+                for(size_t k = 0; k < STENCIL_PLANES; k++)
+                    w[k * width + j] = 0.0f;
+                continue;
+            }
+
+            const long center = i * width + j;
+
+            // same summation order as ComputePoint
+            float sum = 0.0f;
+            for(size_t k = 0; k < STENCIL_PLANES - 1; k++)
+                sum += params[center + offsets[k]];
+
+            const float frac = (sum != 0.0f) ? 1.0f / sum : 0.0f;
+            const bool  air  = (map[center] == 0);
+            const float keep = air ? (1.0f - airFlowRate) : 1.0f;
+
+            for(size_t k = 0; k < STENCIL_PLANES - 1; k++)
+                w[k * width + j] = params[center + offsets[k]] * frac * keep;
+
+            w[(STENCIL_PLANES - 1) * width + j] = air ? airFlowRate * coolerTemp : 0.0f;
+        }
+    }
+}
+
+
+void ComputeRowWeights(const float *oldTemp,
+                       float       *newTemp,
+                       const float *weights,
+                       size_t       i,
+                       size_t       jStart,
+                       size_t       jEnd,
+                       size_t       edgeSize)
+{
+    const float * t0 = oldTemp + i * edgeSize;
+    const float * t1 = t0 - edgeSize;
+    const float * t2 = t0 - 2 * edgeSize;
+    const float * b1 = t0 + edgeSize;
+    const float * b2 = t0 + 2 * edgeSize;
+
+    const float * w = weights + i * STENCIL_PLANES * edgeSize;
+    float * out = newTemp + i * edgeSize;
+
+    size_t j = jStart;
+
+    for(; j + VLEN <= jEnd; j += VLEN){
+
+        vfloat pointTemp = vload(w + 9 * edgeSize + j);
+
+        pointTemp = vfma(vload(w                + j), vload(t1 + j),     pointTemp);
+        pointTemp = vfma(vload(w + edgeSize     + j), vload(t2 + j),     pointTemp);
+        pointTemp = vfma(vload(w + 2 * edgeSize + j), vload(b1 + j),     pointTemp);
+        pointTemp = vfma(vload(w + 3 * edgeSize + j), vload(b2 + j),     pointTemp);
+        pointTemp = vfma(vload(w + 4 * edgeSize + j), vload(t0 + j - 1), pointTemp);
+        pointTemp = vfma(vload(w + 5 * edgeSize + j), vload(t0 + j - 2), pointTemp);
+        pointTemp = vfma(vload(w + 6 * edgeSize + j), vload(t0 + j + 1), pointTemp);
+        pointTemp = vfma(vload(w + 7 * edgeSize + j), vload(t0 + j + 2), pointTemp);
+        pointTemp = vfma(vload(w + 8 * edgeSize + j), vload(t0 + j),     pointTemp);
+
+        vstore(out + j, pointTemp);
+    }
+
+    for(; j < jEnd; j++)
+        ComputePointWeights(oldTemp, newTemp, weights, i, j, edgeSize);
+}
+
+
+/**
+ * Printable kernel name
+ * @param [in] kernel - TKernel value
+ */
+const char * KernelName(int kernel)
+{
+    switch(kernel){
+        case KERNEL_SCALAR: return "scalar";
+        case KERNEL_SIMD:   return "simd";
+        case KERNEL_WEIGHTS: return "weights";
+        default:            return "unknown";
+    }
+}
+
+/**
+ * Vector extension the SIMD kernel was compiled for
+ */
+const char * SimdExtension()
+{
+    return SIMD_EXT;
+}
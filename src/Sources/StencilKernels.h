@@ -0,0 +1,237 @@
+/**
+ * @file        StencilKernels.h
+ *
+ * @brief       Heat distribution stencil kernels
+ *
+ * @detail
+ * Scalar point kernel used by the sequential reference version and
+ * row kernels used by the parallel version. The SIMD row kernel
+ * processes a whole row segment using the widest vector extension
+ * available at compile time (AVX-512, AVX/AVX2, SSE2).
+ */
+
+#ifndef STENCIL_KERNELS_H
+#define STENCIL_KERNELS_H
+
+#include <cstddef>
+
+/**
+ * @enum TKernel
+ * @brief Row kernel selection (runtime)
+ */
+enum TKernel
+{
+  /// ComputePoint called for every point of the row
+  KERNEL_SCALAR = 0,
+  /// Vectorized row kernel
+  KERNEL_SIMD   = 1,
+  /// Vectorized row kernel using precomputed stencil weights
+  KERNEL_WEIGHTS = 2
+};
+
+
+/**
+ * @var STENCIL_PLANES
+ * @brief Number of weight planes - 9 stencil weights + air flow term
+ *
+ * @details Weights are stored per row in structure-of-arrays form,
+ *          plane k of row i starts at weights[(i * STENCIL_PLANES + k) * edgeSize].
+ *          Order of planes: top[0], top[1], bottom[0], bottom[1],
+ *          left[0], left[1], right[0], right[1], center, air flow term.
+ *          For air points (map == 0) the weights are already scaled by
+ *          (1 - airFlowRate) and the air flow term holds airFlowRate * coolerTemp.
+ */
+const size_t STENCIL_PLANES = 10;
+
+
+/**
+ * @brief Computes one grid point of the heat distribution.
+ *
+ * @param oldTemp     - temperature in time t
+ * @param newTemp     - temperature in time t + 1
+ * @param params      - domain parameters
+ * @param map         - domain map (0 - air, heat is removed by air flow)
+ * @param i, j        - row and column of the point
+ * @param edgeSize    - row stride of all arrays
+ * @param airFlowRate - air flow rate
+ * @param coolerTemp  - cooler temperature
+ */
+inline void ComputePoint(float  *oldTemp,
+                         float  *newTemp,
+                         float  *params,
+                         int    *map,
+                         size_t  i,
+                         size_t  j,
+                         size_t  edgeSize,
+                         float   airFlowRate,
+                         float   coolerTemp)
+{
+    // [i] Calculate neighbor indices
+    const int center    = i * edgeSize + j;
+    const int top[2]    = { center - (int)edgeSize, center - 2*(int)edgeSize };
+    const int bottom[2] = { center + (int)edgeSize, center + 2*(int)edgeSize };
+    const int left[2]   = { center - 1, center - 2};
+    const int right[2]  = { center + 1, center + 2};
+
+    // [ii] The reciprocal value of the sum of domain parameters for normalization
+    const float frac = 1.0f / (params[top[0]]    + params[top[1]]    +
+                            params[bottom[0]] + params[bottom[1]] +
+                            params[left[0]]   + params[left[1]]   +
+                            params[right[0]]  + params[right[1]]  +
+                            params[center]);
+
+    // [iii] Calculate new temperature in the grid point
+    float pointTemp =
+        oldTemp[top[0]]    * params[top[0]]    * frac +
+        oldTemp[top[1]]    * params[top[1]]    * frac +
+        oldTemp[bottom[0]] * params[bottom[0]] * frac +
+        oldTemp[bottom[1]] * params[bottom[1]] * frac +
+        oldTemp[left[0]]   * params[left[0]]   * frac +
+        oldTemp[left[1]]   * params[left[1]]   * frac +
+        oldTemp[right[0]]  * params[right[0]]  * frac +
+        oldTemp[right[1]]  * params[right[1]]  * frac +
+        oldTemp[center]    * params[center]    * frac;
+
+    // [iv] Remove some of the heat due to air flow (5% of the new air)
+    pointTemp = (map[center] == 0)
+              ? (airFlowRate * coolerTemp) + ((1.0f - airFlowRate) * pointTemp)
+              : pointTemp;
+
+    newTemp[center] = pointTemp;
+}
+
+
+/**
+ * @brief Computes one grid point using precomputed weights.
+ *
+ * @param oldTemp  - temperature in time t
+ * @param newTemp  - temperature in time t + 1
+ * @param weights  - weights built by BuildStencilWeights
+ * @param i, j     - row and column of the point
+ * @param edgeSize - row stride of temperature arrays
+ */
+inline void ComputePointWeights(const float *oldTemp,
+                                float       *newTemp,
+                                const float *weights,
+                                size_t       i,
+                                size_t       j,
+                                size_t       edgeSize)
+{
+    const size_t center = i * edgeSize + j;
+    const float * w = weights + i * STENCIL_PLANES * edgeSize + j;
+
+    newTemp[center] = w[9 * edgeSize] +
+                      w[0]            * oldTemp[center - edgeSize]   +
+                      w[edgeSize]     * oldTemp[center - 2*edgeSize] +
+                      w[2 * edgeSize] * oldTemp[center + edgeSize]   +
+                      w[3 * edgeSize] * oldTemp[center + 2*edgeSize] +
+                      w[4 * edgeSize] * oldTemp[center - 1]          +
+                      w[5 * edgeSize] * oldTemp[center - 2]          +
+                      w[6 * edgeSize] * oldTemp[center + 1]          +
+                      w[7 * edgeSize] * oldTemp[center + 2]          +
+                      w[8 * edgeSize] * oldTemp[center];
+}
+
+
+/**
+ * @brief Fills weight planes for all points of the block, which
+ *        have complete stencil inside the block.
+ *
+ * @param params      - domain parameters (block including halo zones)
+ * @param map         - domain map (block including halo zones)
+ * @param weights     - output, STENCIL_PLANES * width * height floats
+ * @param width       - row stride of the block
+ * @param height      - number of rows of the block
+ * @param airFlowRate - air flow rate
+ * @param coolerTemp  - cooler temperature
+ */
+void BuildStencilWeights(const float *params,
+                         const int   *map,
+                         float       *weights,
+                         size_t       width,
+                         size_t       height,
+                         float        airFlowRate,
+                         float        coolerTemp);
+
+
+/**
+ * @brief Computes points [i, jStart) .. [i, jEnd) calling ComputePoint.
+ */
+void ComputeRowScalar(float  *oldTemp,
+                      float  *newTemp,
+                      float  *params,
+                      int    *map,
+                      size_t  i,
+                      size_t  jStart,
+                      size_t  jEnd,
+                      size_t  edgeSize,
+                      float   airFlowRate,
+                      float   coolerTemp);
+
+/**
+ * @brief Computes points [i, jStart) .. [i, jEnd) using SIMD lanes.
+ *
+ * @details Same arithmetic as ComputePoint, air flow blend is done
+ *          by a mask built from map. Remainder of the row is computed
+ *          by the scalar kernel.
+ */
+void ComputeRowSimd(float  *oldTemp,
+                    float  *newTemp,
+                    float  *params,
+                    int    *map,
+                    size_t  i,
+                    size_t  jStart,
+                    size_t  jEnd,
+                    size_t  edgeSize,
+                    float   airFlowRate,
+                    float   coolerTemp);
+
+
+/**
+ * @brief Computes points [i, jStart) .. [i, jEnd) from precomputed weights
+ *        using SIMD lanes (9 multiply-adds per point).
+ */
+void ComputeRowWeights(const float *oldTemp,
+                       float       *newTemp,
+                       const float *weights,
+                       size_t       i,
+                       size_t       jStart,
+                       size_t       jEnd,
+                       size_t       edgeSize);
+
+
+/**
+ * @brief Computes row segment using selected kernel.
+ *
+ * @details weights are used by KERNEL_WEIGHTS only, may be NULL otherwise.
+ */
+inline void ComputeRow(int          kernel,
+                       float       *oldTemp,
+                       float       *newTemp,
+                       float       *params,
+                       int         *map,
+                       const float *weights,
+                       size_t       i,
+                       size_t       jStart,
+                       size_t       jEnd,
+                       size_t       edgeSize,
+                       float        airFlowRate,
+                       float        coolerTemp)
+{
+    if(kernel == KERNEL_WEIGHTS)
+        ComputeRowWeights(oldTemp, newTemp, weights, i, jStart, jEnd, edgeSize);
+    else if(kernel == KERNEL_SIMD)
+        ComputeRowSimd(oldTemp, newTemp, params, map, i, jStart, jEnd,
+                       edgeSize, airFlowRate, coolerTemp);
+    else
+        ComputeRowScalar(oldTemp, newTemp, params, map, i, jStart, jEnd,
+                         edgeSize, airFlowRate, coolerTemp);
+}
+
+/// Printable kernel name
+const char * KernelName(int kernel);
+
+/// Vector extension used by ComputeRowSimd
+const char * SimdExtension();
+
+#endif /* STENCIL_KERNELS_H */
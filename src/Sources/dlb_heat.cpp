@@ -34,10 +34,18 @@
 #include <sstream>
 #include <iostream>
 #include <new>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 #include "MaterialProperties.h"
 #include "BasicRoutines.h"
+#include "StencilKernels.h"
 
 // Dynamic Load Balancing files
 #include <Asserts.h>
@@ -46,6 +54,8 @@
 #include <BlockData.h>
 #include <Dims.h>
 #include <HaloBuffers.h>
+#include <HaloExchanger.h>
+#include <RowScheduler.h>
 
 
 
@@ -61,6 +71,9 @@ using namespace DLB;
 // for testing only - value from user params should be used
 const Dims OBJSIZE(16,16);
 
+// rows computed between MPI_Testall calls (PROGRESS_POLL)
+const int POLL_ROWS = 16;
+
 // some std stuff
 using std::cout;
 using std::endl;
@@ -113,6 +126,7 @@ void StoreDataIntoFileParallel(hid_t h5fileId,
                                const size_t edgeSize,
                                const size_t tileWidth, const size_t tileHeight,
                                const size_t tilePosX, const size_t tilePosY,
+                               const size_t haloSize,
                                const size_t snapshotId,
                                const size_t iteration);
 // ----------------------
@@ -120,129 +134,6 @@ void StoreDataIntoFileParallel(hid_t h5fileId,
 // ----------------------
 
 
-/**
- * @brief Template function copying halo zone
- *        to linear buffer, to be send over MPI.
- *        
- * @details Expects data block extended by halo zone of size = 2
- *          on every side.
- * 
- * @param block - original data block
- * @param buff - allocated buffer with sufficient size ( = 2 * block perimeter)
- * @param ext - size of block including halo zones
- */
-
-template <class T>
-void HaloToBuff(T * block, T * buff, Dims ext)
-{
-    unsigned offset = 0;
-    bool once = true;
-
-    //top
-    for(unsigned i = 2; i < 4;i++){
-      for(unsigned j = 2; j < ext.x-2; j++){
-
-        buff[offset] = block[i * ext.x + j];
-        offset += 2;
-      }
-
-      if(once){
-        offset = 1;
-        once = false;
-      }
-    }
-    offset -= 1;
-
-    // right
-    for(unsigned j = 2; j < ext.y-2;j++){
-      for(unsigned i = ext.x - 4;i < ext.x -2;i++){
-        buff[offset] = block[j * ext.x + i];
-        offset++;
-      }
-    }
-
-    //left
-    for(unsigned j = 2; j < ext.y-2;j++){
-      for(unsigned i = 2 ;i < 4 ;i++){
-        buff[offset] = block[j * ext.x + i];
-        offset++;
-      }
-    }
-
-    //bottom
-    unsigned tmp = offset;
-
-    for(unsigned i = ext.y - 4; i < ext.y - 2;i++){
-      for(unsigned j = 2; j < ext.x-2;j++){
-
-        buff[offset] = block[i * ext.x + j];
-        offset += 2;
-      }
-      offset = tmp + 1;
-    }
-
-  
-}
-
-/**
- * @brief Copies data from linear buffer to halo zones.
- * 
- * @details Expects data block extended by halo zone of size = 2
- *          on every side.
- * 
- * @param block - original data block
- * @param buff - allocated buffer with sufficient size ( = 2 * block perimeter)
- * @param ext - size of block including halo zones
- */
-
-template <class T>
-void BuffToHalo(T * block, T * buff, Dims ext)
-{
-    unsigned offset = 0;
-    bool once = true;
-
-    //top
-    for(unsigned i = 0; i < 2;i++){
-      for(unsigned j = 2; j < ext.x-2; j++){
-
-        block[i * ext.x + j] = buff[offset];
-        offset += 2;
-      }
-      if(once){
-        offset = 1;
-        once = false;
-      }
-    }
-    offset -= 1;
-
-    // right
-    for(unsigned j = 2; j < ext.y-2;j++){
-      for(unsigned i = ext.x - 2;i < ext.x ;i++){
-        block[j * ext.x + i] = buff[offset];
-        offset++;
-      }
-    }
-
-    //left
-    for(unsigned j = 2; j < ext.y-2;j++){
-      for(unsigned i = 0 ;i < 2 ;i++){
-        block[j * ext.x + i] = buff[offset];
-        offset++;
-      }
-    }
-
-    // bottom
-    unsigned tmp = offset;
-    for(unsigned i = ext.y - 2; i < ext.y;i++){
-      for(unsigned j = 2; j < ext.x-2;j++){
-
-        block[i * ext.x + j] = buff[offset];
-        offset += 2;
-      }
-      offset = tmp + 1;
-    }
-}
-
 /**
  * @brief Printable block representation
  * 
@@ -309,50 +200,6 @@ void PrintBlock(T * block, Dims extSize, int rank, bool extended)
 //----------------------------------------------------------------------------//
 
 
-void ComputePoint(float  *oldTemp,
-                  float  *newTemp,
-                  float  *params,
-                  int    *map,
-                  size_t  i,
-                  size_t  j,
-                  size_t  edgeSize,
-                  float   airFlowRate,
-                  float   coolerTemp)
-{
-    // [i] Calculate neighbor indices
-    const int center    = i * edgeSize + j;
-    const int top[2]    = { center - (int)edgeSize, center - 2*(int)edgeSize };
-    const int bottom[2] = { center + (int)edgeSize, center + 2*(int)edgeSize };
-    const int left[2]   = { center - 1, center - 2};
-    const int right[2]  = { center + 1, center + 2};
-
-    // [ii] The reciprocal value of the sum of domain parameters for normalization
-    const float frac = 1.0f / (params[top[0]]    + params[top[1]]    +
-                            params[bottom[0]] + params[bottom[1]] +
-                            params[left[0]]   + params[left[1]]   +
-                            params[right[0]]  + params[right[1]]  +
-                            params[center]);
-
-    // [iii] Calculate new temperature in the grid point
-    float pointTemp = 
-        oldTemp[top[0]]    * params[top[0]]    * frac +
-        oldTemp[top[1]]    * params[top[1]]    * frac +
-        oldTemp[bottom[0]] * params[bottom[0]] * frac +
-        oldTemp[bottom[1]] * params[bottom[1]] * frac +
-        oldTemp[left[0]]   * params[left[0]]   * frac +
-        oldTemp[left[1]]   * params[left[1]]   * frac +
-        oldTemp[right[0]]  * params[right[0]]  * frac +
-        oldTemp[right[1]]  * params[right[1]]  * frac +
-        oldTemp[center]    * params[center]    * frac;
-
-    // [iv] Remove some of the heat due to air flow (5% of the new air)
-    pointTemp = (map[center] == 0)
-              ? (airFlowRate * coolerTemp) + ((1.0f - airFlowRate) * pointTemp)
-              : pointTemp;
-
-    newTemp[center] = pointTemp;
-}
-
 /**
  * Sequential version of the Heat distribution in heterogenous 2D medium
  * @param [out] seqResult          - Final heat distribution
@@ -485,170 +332,185 @@ void SequentialHeatDistribution(float                      *seqResult,
 
 
 /**
- * @brief Exchange all halo zones (temp, params, map)on topology change.
+ * @brief Computes single simulation step on rectangle of the block.
  * 
+ * @details Rectangle is given by rows <top, bottom) and columns <left, right)
+ *          of block including halo zones. Empty rectangle is skipped.
+ *          Rows are split among threads statically, or by work stealing
+ *          scheduler if given.
  */
-
-void ExchangeHaloZones( BlockData &bd,
-                        DynamicBlockDescriptor & dbd,
-                        float * sendTemp,
-                        float * recvTemp,
-                        float * sendParams,
-                        float * recvParams,
-                        const int * cts, //scatter counts 
-                        const int * dpsl // scatter displs
-                    )
+void ComputeRegion(BlockData & bd, Dims ext, int top, int bottom, int left, int right,
+                   float airFlowRate, float coolerTemp, int kernel, RowScheduler * sched = NULL)
 {
-    // size for all requests
-    // int size = bd.neighbors->size()*3 + 3;
-
-    MPI_Request  * send = new MPI_Request[2];
-    MPI_Status * sendSt = new MPI_Status[2];
-
-    MPI_Request  * recv = new MPI_Request[bd.neighbors->size() * 2];
-    MPI_Status * recvSt = new MPI_Status[bd.neighbors->size() * 2];
-
-    unsigned nCount = 0;
-
-
-    if(DBG){
-        char  * name = new char[MPI_MAX_OBJECT_NAME];
-        int l, size;
-        MPI_Comm_get_name( bd.myComm, name, &l);
-        MPI_Comm_size( bd.myComm, &size);
-        stringstream ss;
-        ss << dbd.rank << " sending on comm " << name << " of size " << size <<   endl;
-        synCout(ss.str(), dbd.rank, dbd.worldSize, bd.myComm);
-    }
-
-    MPI_assert( MPI_Iscatterv(sendTemp, cts, dpsl, MPI_FLOAT,  NULL, 0, MPI_FLOAT, bd.myCommRank, bd.myComm, &(send[0]) ),
-       "Iscatter temp send failed" LOCATION );
-    MPI_assert( MPI_Iscatterv(sendParams, cts, dpsl, MPI_FLOAT, NULL, 0, MPI_FLOAT, bd.myCommRank, bd.myComm, &(send[1])), 
-      "Iscatter params send failed" LOCATION );
-
-    for(auto it = bd.neighbors->begin(); it < bd.neighbors->end();it++){
-
-        if(DBG){
-            char  * name = new char[MPI_MAX_OBJECT_NAME];
-            int l, size;
-            MPI_Comm_get_name( bd.nData->at(*it).comm, name, &l);
-            MPI_Comm_size(bd.nData->at(*it).comm, &size); 
-            stringstream ss;
-            ss << dbd.rank << " receiving "  << " on " << name << " of size " << size<< endl;
-            synCout(ss.str(), dbd.rank, dbd.worldSize, bd.nData->at(*it).comm );
+    if(left >= right)
+        return;
+
+    auto rows = [&](int begin, int end){
+
+        for(int i = begin; i < end; i++){
+
+            ComputeRow(kernel,
+                       bd.oldTemp,
+                       bd.newTemp,
+                       bd.domParams,
+                       bd.domMap,
+                       bd.weights,
+                       i, left, right,
+                       ext.x,
+                       airFlowRate,
+                       coolerTemp
+                       );
         }
-        // MPI_Barrier(bd.nData->at(*it).comm);
-        MPI_assert( MPI_Iscatterv(NULL, bd.nData->at(*it).scatterCnts, bd.nData->at(*it).scatterDispls, MPI_FLOAT, 
-            &(recvTemp[ bd.nData->at(*it).displ ]), bd.nData->at(*it).count, 
-            MPI_FLOAT, bd.nData->at(*it).root, bd.nData->at(*it).comm, &(recv[nCount + 0]) ), 
-            "Iscatter temp send failed" LOCATION );
-        MPI_assert( MPI_Iscatterv(NULL, bd.nData->at(*it).scatterCnts, bd.nData->at(*it).scatterDispls, MPI_FLOAT, 
-            &(recvParams[bd.nData->at(*it).displ]), bd.nData->at(*it).count, MPI_FLOAT, 
-            bd.nData->at(*it).root, bd.nData->at(*it).comm, &(recv[nCount + 1])), 
-            "Iscatter params send failed" LOCATION );
-          
-        nCount+= 2;
-    }
-        
-    MPI_assert( MPI_Waitall( 2, send, recvSt), "Receive waitall failed" LOCATION);
-
-   
-    MPI_assert( MPI_Waitall(bd.neighbors->size()*2, recv, recvSt), "Receive waitall failed" LOCATION);
+    };
 
-    delete[] send;
-    delete[] sendSt;
-    delete[] recv;
-    delete[] recvSt;
-
-    return;
+    if(sched != NULL){
+        sched->run(top, bottom, rows);
+        return;
+    }
 
+    // row bands, same static schedule as first touch in DBD::initNewBlock
+    #pragma omp parallel for schedule(static) if(bottom - top > 1)
+    for(int i = top; i < bottom; i++)
+        rows(i, i + 1);
 }
 
 /**
  * @brief Function computing single simulation step on halo zones only.
  * 
  * @details Increases code readability when communication overlap should be used.
+ *          Computes strips of halo zone width along block edges shared
+ *          with neighbors, eg. all points sent to neighbors.
  * 
  * @param bd  - BlockData instance
  * @param dbd - DynamicBlockDescriptor
  * @param airFlowRate - air flow param
  * @param coolerTemp - cooler temperature param
+ * @param kernel - stencil kernel (TKernel)
  */
-void ComputeHalo(BlockData & bd, DynamicBlockDescriptor & dbd, float airFlowRate, float  coolerTemp)
+void ComputeHalo(BlockData & bd, DynamicBlockDescriptor & dbd, float airFlowRate, float  coolerTemp, int kernel)
 {
 
     Dims ext = dbd.getExtSize();
+    int h = dbd.getHaloSize();
+
     //top
     if(! bd.topF){
-        for(unsigned i = bd.top; i < bd.top + 2;i++)  {
-          for(unsigned j = bd.left; j < bd.right;j++){
-    
-            ComputePoint(bd.oldTemp,
-                         bd.newTemp,
-                         bd.domParams,
-                         bd.domMap,
-                         i, j,
-                         ext.x, 
-                         airFlowRate,
-                         coolerTemp
-                         );
-          }
-        }
+        ComputeRegion(bd, ext, bd.top, std::min<int>(bd.top + h, bd.bottom), bd.left, bd.right,
+                      airFlowRate, coolerTemp, kernel);
     }
 
     // righ
     if(! bd.rightF){
-        for(unsigned i = bd.right - 2;i < bd.right;i++){
-          for(unsigned j = bd.top; j <bd.bottom;j++){
-    
-              ComputePoint(bd.oldTemp,
-                         bd.newTemp,
-                         bd.domParams,
-                         bd.domMap,
-                         j, i,
-                         ext.x, 
-                         airFlowRate,
-                         coolerTemp
-                         );
-          }
-        }
+        ComputeRegion(bd, ext, bd.top, bd.bottom, std::max<int>(bd.right - h, bd.left), bd.right,
+                      airFlowRate, coolerTemp, kernel);
     }
 
     //bottom
     if(! bd.bottomF){
-        for(unsigned i = bd.bottom - 2;i < bd.bottom ;i++){
-          for(unsigned j = bd.left; j < bd.right;j++){
-    
-              ComputePoint(bd.oldTemp,
-                         bd.newTemp,
-                         bd.domParams,
-                         bd.domMap,
-                         i, j,
-                         ext.x, 
-                         airFlowRate,
-                         coolerTemp
-                         );
-          }
-        }
+        ComputeRegion(bd, ext, std::max<int>(bd.bottom - h, bd.top), bd.bottom, bd.left, bd.right,
+                      airFlowRate, coolerTemp, kernel);
     }
 
     //left
     if(! bd.leftF){
-        for(unsigned i = bd.left ;i < bd.left+2 ;i++){
-          for(unsigned j = bd.top; j < bd.bottom;j++){
-    
-             ComputePoint(bd.oldTemp,
-                         bd.newTemp,
-                         bd.domParams,
-                         bd.domMap,
-                         j, i,
-                         ext.x, 
-                         airFlowRate,
-                         coolerTemp
-                         );
-            }
+        ComputeRegion(bd, ext, bd.top, bd.bottom, bd.left, std::min<int>(bd.left + h, bd.right),
+                      airFlowRate, coolerTemp, kernel);
+    }
+}
+
+
+/**
+ * @brief Computes single simulation step on the whole block object by object.
+ *
+ * @details Compute time of every object is stored to costs, in order
+ *          of DBD::getAssignGIDs(). Objects are spread among threads,
+ *          rows of an object are not split. Used once per balancing period
+ *          instead of ComputeHalo and the rest, exchange is not overlapped.
+ *
+ * @param costs - array of objects count of actual tile (DBD::getObjCosts)
+ */
+void ComputeObjects(BlockData & bd, DynamicBlockDescriptor & dbd, float airFlowRate, float coolerTemp,
+                    int kernel, float * costs)
+{
+    Dims ext = dbd.getExtSize();
+    Dims obj = dbd.getObjectSize();
+    int h = dbd.getHaloSize();
+
+    int objX = (ext.x - 2 * h) / obj.x;
+    int objY = (ext.y - 2 * h) / obj.y;
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int o = 0; o < objX * objY; o++){
+
+        // domain border points are not computed
+        int top = std::max<int>(h + (o / objX) * obj.y, bd.top);
+        int bottom = std::min<int>(h + (o / objX + 1) * obj.y, bd.bottom);
+        int left = std::max<int>(h + (o % objX) * obj.x, bd.left);
+        int right = std::min<int>(h + (o % objX + 1) * obj.x, bd.right);
+
+        auto start = std::chrono::steady_clock::now();
+
+        if(top < bottom)
+            ComputeRegion(bd, ext, top, bottom, left, right, airFlowRate, coolerTemp, kernel);
+
+        costs[o] = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+
+/**
+ * @brief Chooses the fastest halo exchange backend for actual topology
+ *
+ * @details Every backend (TExchange) is planned in turn and times rounds
+ *          of oldTemp exchange, interior is not changed, so rounds are
+ *          idempotent. Time of the slowest rank counts. DBD is left set up
+ *          for the chosen backend.
+ *
+ * @param timings [out] - seconds per exchange of every backend
+ * @return chosen backend
+ */
+int SelectExchange(DynamicBlockDescriptor & dbd, BlockData & bd, int progress, std::vector<double> & timings)
+{
+    const int warmup = 2;
+    const int rounds = 20;
+
+    int best = EXCHANGE_SCATTER;
+    timings.assign(EXCHANGE_RMA + 1, 0.0);
+
+    for(int e = EXCHANGE_SCATTER; e <= EXCHANGE_RMA; e++){
+
+        bd = dbd.setExchange(e);
+
+        // buffers outlive exchanger, RMA window is bound to them
+        HaloBuffers hb(dbd.getHaloLen());
+        std::unique_ptr<HaloExchanger> hx(HaloExchanger::create(e, progress));
+
+        hx->plan(bd, hb, dbd.getExtSize());
+
+        for(int i = 0; i < warmup; i++){
+            hx->start(bd.oldTemp);
+            hx->wait(bd.oldTemp);
+        }
+
+        hx->resetCounters();
+        MPI_assert(MPI_Barrier(MPI_COMM_WORLD));
+
+        for(int i = 0; i < rounds; i++){
+            hx->start(bd.oldTemp);
+            hx->wait(bd.oldTemp);
         }
+
+        double t = hx->getTime() / hx->getExchanges();
+
+        MPI_assert( MPI_Allreduce(&t, &timings[e], 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD) LOCATION);
+
+        if(timings[e] < timings[best])
+            best = e;
     }
+
+    bd = dbd.setExchange(best);
+
+    return best;
 }
 
 
@@ -700,12 +562,21 @@ float * Behavior(   const TMaterialProperties  &materialProperties,
                                size,
                                parameters.edgeSize,
                                Dims(parameters.objDim, parameters.objDim),
-                               parameters.threshold
+                               parameters.threshold,
+                               2 * parameters.temporalSteps,
+                               parameters.exchange,
+                               parameters.strategy,
+                               parameters.hysteresis,
+                               parameters.migrationBudget,
+                               parameters.asyncLag,
+                               parameters.nativeMigration,
+                               parameters.nodeAware,
+                               parameters.nodePlacement
                                );
 
     BlockData bd;
 
-    PerfMeasure pm(rank, size, parameters.balancePeriod);
+    PerfMeasure pm(rank, size, parameters.balancePeriod, parameters.estimator);
 
     dbd.zoltanInit();
 
@@ -713,144 +584,182 @@ float * Behavior(   const TMaterialProperties  &materialProperties,
     // material properties may be empty in others
     bd = dbd.loadInit(materialProperties);
 
-    // float * tempArray = bd.oldTemp;
-    // hallo send and receive buffers
-    HaloBuffers hb(2*dbd.getHaloLen());
+    // backend timings of EXCHANGE_AUTO, empty otherwise
+    std::vector<double> exchangeBench;
+    int exchange = parameters.exchange;
 
-    // store simulation timestamp
-    double totalTime = MPI_Wtime();
+    if(exchange == EXCHANGE_AUTO)
+        exchange = SelectExchange(dbd, bd, parameters.progress, exchangeBench);
 
-    float middleColAvgTemp = 0.0f;
+    // float * tempArray = bd.oldTemp;
+    // hallo send and receive buffers, outlive exchanger (RMA window is bound to them)
+    HaloBuffers hb;
+    // requests for halo exchange, rebuilt on topology change
+    std::unique_ptr<HaloExchanger> hx(HaloExchanger::create(exchange, parameters.progress));
 
-    // pack halo zones to buffers
-    HaloToBuff<float>(bd.oldTemp, hb.sendTemp, dbd.getExtSize());
-    HaloToBuff<float>(bd.domParams, hb.sendParams, dbd.getExtSize());
-    HaloToBuff<int>(bd.domMap, hb.sendMap, dbd.getExtSize());
+    hb.resize(hx->getBufferLen(dbd.getHaloLen()));
 
-    int * cnts = new int[bd.counts->size()];
-    int * displs = new int[bd.displs->size()];
+    if(exchange == EXCHANGE_RMA && parameters.progress == PROGRESS_THREAD && rank == 0)
+        printf("WARNING: progress thread cannot drive RMA epochs, no progress used\n");
 
-    for(unsigned i = 0; i < bd.counts->size();i++){
-        cnts[i] = bd.counts->at(i);
-        displs[i] = bd.displs->at(i);
-    }
+    // intra rank balancing of rows between threads, static bands if disabled
+    RowScheduler sched(parameters.rowChunk);
+    RowScheduler * rs = parameters.rowChunk > 0 ? &sched : NULL;
 
-    ExchangeHaloZones(bd, dbd, hb.sendTemp, hb.recvTemp, hb.sendParams, hb.recvParams, cnts, displs);
+    // object costs are sampled in the first exchange step of balancing period
+    bool sampleCosts = parameters.balance && parameters.costModel;
 
-    BuffToHalo<float>(bd.oldTemp, hb.recvTemp, dbd.getExtSize());
-    BuffToHalo<float>(bd.domParams, hb.recvParams, dbd.getExtSize());
-    BuffToHalo<int>(bd.domMap, hb.recvMap, dbd.getExtSize());
+    // store simulation timestamp
+    double totalTime = MPI_Wtime();
 
-    // Asynchronous requests
+    float middleColAvgTemp = 0.0f;
 
-    MPI_Request *req = new MPI_Request[bd.neighbors->size()+1];
-    MPI_Status * stat = new MPI_Status[bd.neighbors->size()+1];
+    hx->plan(bd, hb, dbd.getExtSize());
+    hx->exchangeInit();
 
-    float  dummyF[1];
+    if(parameters.kernel == KERNEL_WEIGHTS)
+        dbd.updateWeights(bd, parameters.airFlowRate, materialProperties.coolerTemp);
 
     // main simulatilson loop
     bool once = true;
+
+    // halo zones are exchanged once per temporalSteps iterations
+    const unsigned steps = parameters.temporalSteps;
     
     for(unsigned iter = 0; iter < parameters.nIterations; iter++){
 
+        // iterations left to next exchange, the last block of steps may be shorter
+        unsigned blockStart = iter - (iter % steps);
+        unsigned blockLen = std::min<size_t>(steps, parameters.nIterations - blockStart);
+        unsigned rem = blockLen - (iter - blockStart) - 1;
 
-        if(parameters.balance && pm.periodElapsed()){
+        // incremental migration continues every exchange step,
+        // background migration waits for its cutover
+        bool cutover = dbd.asyncDue();
+        bool stepping = dbd.migrationPending() || cutover;
+        bool waiting = dbd.asyncPending() && !cutover;
+
+        // topology may change only when halo zones are valid
+        if(parameters.balance && rem == blockLen - 1 && !waiting && (stepping || pm.periodElapsed())){
             if(DBG && rank == 0) cout << "detecting" << endl;
   
             pm.balStart();
 
-            if( dbd.loadBalance(pm, bd) ){
+            bool changed = cutover  ? dbd.asyncCutover(bd)
+                         : stepping ? dbd.migrateStep(bd)
+                                    : dbd.loadBalance(pm, bd, parameters.costGate ? parameters.nIterations - iter : 0);
+
+            if( changed ){
 
       
                 if(DBG && rank == 0){
                   cout << "balancing" << endl;
                 }
 
-                hb.resize(2*dbd.getHaloLen());
-
-                HaloToBuff<float>(bd.oldTemp, hb.sendTemp, dbd.getExtSize());
-                HaloToBuff<float>(bd.domParams, hb.sendParams, dbd.getExtSize());
-                HaloToBuff<int>(bd.domMap, hb.sendMap, dbd.getExtSize());
-
-                delete[] cnts;
-                delete[] displs;
-                delete[] req;
-                delete[] stat;
-            
-                cnts = new int[bd.counts->size()];
-                displs = new int[bd.displs->size()];
-                req = new MPI_Request[bd.neighbors->size() + 1];
-                stat = new MPI_Status[bd.neighbors->size() + 1];
-
-                for(unsigned i = 0; i < bd.counts->size();i++){
-                    cnts[i] = bd.counts->at(i);
-                    displs[i] = bd.displs->at(i);
-                }
-            
-                ExchangeHaloZones(bd, dbd, hb.sendTemp, hb.recvTemp, hb.sendParams, hb.recvParams, cnts, displs);
-            
-                BuffToHalo<float>(bd.oldTemp, hb.recvTemp, dbd.getExtSize());
-                BuffToHalo<float>(bd.domParams, hb.recvParams, dbd.getExtSize());
-                BuffToHalo<int>(bd.domMap, hb.recvMap, dbd.getExtSize());
+                // window and requests are bound to old buffers
+                hx->release();
+                hb.resize(hx->getBufferLen(dbd.getHaloLen()));
+
+                hx->plan(bd, hb, dbd.getExtSize());
+                hx->exchangeInit();
+
+                // tile changed, weights have to be rebuilt
+                if(parameters.kernel == KERNEL_WEIGHTS)
+                    dbd.updateWeights(bd, parameters.airFlowRate, materialProperties.coolerTemp);
 
                 MPI_assert(MPI_Barrier(MPI_COMM_WORLD));
 
+                pm.balStop();
+                dbd.recordMigration(pm.balance);
+
+            }else{
+
+                pm.balStop();
             }
-            pm.balStop();
 
-            pm.reset();
+            // next period is measured on target layout
+            if(!dbd.migrationPending() && !dbd.asyncPending()){
+
+                pm.reset();
+
+                sampleCosts = parameters.costModel;
+            }
         } //balancing end
 
+        dbd.asyncProgress();
+
         pm.iterStart(); //timestamp
 
         pm.imbalDelay(bd.middle, iter, parameters.nIterations, parameters.multiply);
 
 
-        // compute halo zones
-        ComputeHalo(bd, dbd, parameters.airFlowRate, materialProperties.coolerTemp);
+        if(rem == 0 && sampleCosts){
 
-        // init communications
-        HaloToBuff<float>(bd.newTemp, hb.sendTemp, dbd.getExtSize());
+            ComputeObjects(bd, dbd, parameters.airFlowRate, materialProperties.coolerTemp, parameters.kernel,
+                           dbd.getObjCosts());
 
-        MPI_assert( MPI_Iscatterv(hb.sendTemp, cnts, displs, MPI_FLOAT, &dummyF, 0, MPI_FLOAT, bd.myCommRank, bd.myComm, &(req[0])),
-                     "Temp scatter send failed" LOCATION );
+            pm.commStart();
+            hx->start(bd.newTemp);
 
-        int idx = 1;
-        for(auto n : *bd.neighbors){
+            sampleCosts = false;
 
-            MPI_assert( MPI_Iscatterv(NULL, bd.nData->at(n).scatterCnts, bd.nData->at(n).scatterDispls,
-                                     MPI_FLOAT,
-                                     &(hb.recvTemp[bd.nData->at(n).displ]), bd.nData->at(n).count, MPI_FLOAT, 
-                                     bd.nData->at(n).root, bd.nData->at(n).comm, &(req[idx])),
-                    "Temp scatter receive failed" LOCATION );
-            idx++;
-        }
+        }else if(rem == 0){
 
-        if(DBG && once){
-            cout << rank << " " << bd;
-            once = false;
-        }
-        // compute the rest 
-        unsigned top, right, bottom, left;
-
-        top = bd.topF ? bd.top : bd.top + 2;
-        right = bd.rightF ? bd.right : bd.right-2;
-        bottom = bd.bottomF ? bd.bottom : bd.bottom - 2;
-        left = bd.leftF ? bd.left : bd.left + 2;
-
-        for(unsigned i = top; i < bottom ;i++){
-            for(unsigned j = left; j < right ; j++){
-            
-                ComputePoint(bd.oldTemp,
-                             bd.newTemp,
-                             bd.domParams,
-                             bd.domMap,
-                             i, j,
-                             dbd.getExtSize().x, 
-                             parameters.airFlowRate,
-                             materialProperties.coolerTemp
-                             );
+            // compute halo zones
+            ComputeHalo(bd, dbd, parameters.airFlowRate, materialProperties.coolerTemp, parameters.kernel);
+
+            // init communications
+            pm.commStart();
+            hx->start(bd.newTemp);
+
+            if(DBG && once){
+                cout << rank << " " << bd;
+                once = false;
             }
+            // compute the rest 
+            int h = dbd.getHaloSize();
+            int top, right, bottom, left;
+
+            top = bd.topF ? bd.top : bd.top + h;
+            right = bd.rightF ? bd.right : bd.right - h;
+            bottom = bd.bottomF ? bd.bottom : bd.bottom - h;
+            left = bd.leftF ? bd.left : bd.left + h;
+
+            if(parameters.progress == PROGRESS_POLL){
+
+                // give MPI a chance to progress between chunks of rows
+                for(int r = top; r < bottom; r += POLL_ROWS){
+
+                    ComputeRegion(bd, dbd.getExtSize(), r, std::min(r + POLL_ROWS, bottom), left, right,
+                                  parameters.airFlowRate, materialProperties.coolerTemp, parameters.kernel, rs);
+                    hx->test();
+                }
+
+            }else{
+
+                ComputeRegion(bd, dbd.getExtSize(), top, bottom, left, right,
+                              parameters.airFlowRate, materialProperties.coolerTemp, parameters.kernel, rs);
+            }
+
+        }else{
+
+            // inner step of temporal block, no communication
+            // block is extended to halo zones, which stay valid for the next steps,
+            // extension stops at fixed domain border (interior is <2, edgeSize - 2)),
+            // halo zone beyond the domain holds no material
+            int g = 2 * rem;
+            int h = dbd.getHaloSize();
+            int edge = parameters.edgeSize;
+            Dims p = dbd.getPosition();
+            int top, right, bottom, left;
+
+            top = std::max<int>(bd.top - g, h + 2 - p.y);
+            right = std::min<int>(bd.right + g, h + edge - 2 - p.x);
+            bottom = std::min<int>(bd.bottom + g, h + edge - 2 - p.y);
+            left = std::max<int>(bd.left - g, h + 2 - p.x);
+
+            ComputeRegion(bd, dbd.getExtSize(), top, bottom, left, right,
+                          parameters.airFlowRate, materialProperties.coolerTemp, parameters.kernel, rs);
         }
 
         // middle column output
@@ -904,6 +813,7 @@ float * Behavior(   const TMaterialProperties  &materialProperties,
                             dbd.getExtSize().x, dbd.getExtSize().y,
                             dbd.getPosition().x,   //offset in points
                             dbd.getPosition().y,   //offset in points
+                            dbd.getHaloSize(),
                             iter / parameters.diskWriteIntensity,
                             iter
                         );
@@ -941,9 +851,13 @@ float * Behavior(   const TMaterialProperties  &materialProperties,
 
         // stop measuring before blcoking call
         pm.iterStop();
+
         // wait for communications completion
-        MPI_assert( MPI_Waitall(bd.neighbors->size()+1, req, stat), "Waitall failed" LOCATION);
-        BuffToHalo<float>(bd.newTemp, hb.recvTemp, dbd.getExtSize());
+        if(rem == 0){
+            pm.waitStart();
+            hx->wait(bd.newTemp);
+            pm.waitStop();
+        }
 
         // swap original pointers inside dbd as well
         dbd.swap(bd.newTemp, bd.oldTemp); 
@@ -957,10 +871,39 @@ float * Behavior(   const TMaterialProperties  &materialProperties,
         // [7] Print final result
         if (!parameters.batchMode){
             printf("\nExecution time of parallel version %.5f\n", totalTime);
+            printf("Halo exchange overlap %.1f%% (wait %.5f of %.5f)\n",
+                   100.0 * pm.overlap(), pm.waitTotal, pm.commTotal);
+            printf("Halo exchange backend %d, %.5f ms (start to wait) and %.0f B per exchange\n", exchange,
+                   1e3 * hx->getTime() / std::max(1u, hx->getExchanges()),
+                   hx->getBytes() / std::max(1u, hx->getExchanges()));
+
+            for(unsigned e = 0; e < exchangeBench.size(); e++)
+                printf("  backend %u benchmark %.5f ms\n", e, 1e3 * exchangeBench[e]);
         }else{
           cout << "Outfile:" <<  parameters.outputFileName.c_str() << endl;
           cout << "Mode:" << (parameters.balance ? "parBal" : "par") << endl;
           cout << "ObjectSize:" << parameters.objDim << endl;
+          cout << "Kernel:" << KernelName(parameters.kernel) << endl;
+          cout << "TemporalSteps:" << parameters.temporalSteps << endl;
+          cout << "Exchange:" << exchange << endl;
+          cout << "ExchangeBench:";
+          for(auto t : exchangeBench)
+              cout << " " << t;
+          cout << endl;
+          cout << "ExchangeBytes:" << hx->getBytes() / std::max(1u, hx->getExchanges()) << endl;
+          cout << "ExchangeTime:" << hx->getTime() / std::max(1u, hx->getExchanges()) << endl;
+          cout << "Threads:" << parameters.threads << endl;
+          cout << "RowChunk:" << parameters.rowChunk << endl;
+          cout << "Strategy:" << parameters.strategy << endl;
+          cout << "CostModel:" << parameters.costModel << endl;
+          cout << "Estimator:" << parameters.estimator << endl;
+          cout << "Hysteresis:" << parameters.hysteresis << endl;
+          cout << "CostGate:" << parameters.costGate << endl;
+          cout << "MigrationBudget:" << parameters.migrationBudget << endl;
+          cout << "AsyncLag:" << parameters.asyncLag << endl;
+          cout << "NativeMigration:" << parameters.nativeMigration << endl;
+          cout << "NodeAware:" << parameters.nodeAware << endl;
+          cout << "NodePlacement:" << parameters.nodePlacement << endl;
           cout << "MiddleCol:" << middleColAvgTemp << endl;
           cout << "TotalTime:" << totalTime << endl;
           cout << "IterTime:" << totalTime / parameters.nIterations << endl;
@@ -969,18 +912,18 @@ float * Behavior(   const TMaterialProperties  &materialProperties,
           cout << "SleepTotal[ms]:" << pm.sleepTotal << endl;
           cout << "IOTotal:" << pm.ioTotal << endl;
           cout << "BalanceTotal:" << pm.balTotal << endl;
+          cout << "CommTotal:" << pm.commTotal << endl;
+          cout << "WaitTotal:" << pm.waitTotal << endl;
+          cout << "Overlap:" << pm.overlap() << endl;
+          cout << "Steals:" << sched.getSteals() << endl;
           cout << "----" << endl;
 
           }
     } //simulation output end
 
 
-    delete[] cnts;
-    delete[] displs;
-
-    // Asynchronous requests
-    delete[] req ;
-    delete[] stat;
+    // migration decided in last asyncLag iterations is never cut over
+    dbd.asyncCancel();
 
     return dbd.collectData(false);
 }
@@ -1137,6 +1080,7 @@ void StoreDataIntoFile(hid_t         h5fileId,
  * @param [in] tileHeight - height of the tile
  * @param [in] tilePosX   - position of the tile in the grid (X-dir)
  * @param [in] tilePosY   - position of the tile in the grid (Y-dir)
+ * @param [in] haloSize   - width of halo zones
  * @param [in] snapshotId - snapshot id
  * @param [in] iteration  - id of iteration
  */
@@ -1145,6 +1089,7 @@ void StoreDataIntoFileParallel(hid_t h5fileId,
                                const size_t edgeSize,
                                const size_t tileWidth, const size_t tileHeight,
                                const size_t tilePosX, const size_t tilePosY,
+                               const size_t haloSize,
                                const size_t snapshotId,
                                const size_t iteration)
 {
@@ -1152,8 +1097,8 @@ void StoreDataIntoFileParallel(hid_t h5fileId,
     const hsize_t dims[2] = { edgeSize, edgeSize };
     const hsize_t offset[2] = { tilePosY, tilePosX };
     const hsize_t tile_dims[2] = { tileHeight, tileWidth };
-    const hsize_t core_dims[2] = { tileHeight - 4, tileWidth - 4 };
-    const hsize_t core_offset[2] = { 2, 2 };
+    const hsize_t core_dims[2] = { tileHeight - 2*haloSize, tileWidth - 2*haloSize };
+    const hsize_t core_offset[2] = { haloSize, haloSize };
 
     string groupName = "Timestep_" + to_string((unsigned long)snapshotId);
 
@@ -1213,119 +1158,6 @@ void StoreDataIntoFileParallel(hid_t h5fileId,
 }
 //------------------------------------------------------------------------------
 
-/**
- * @brief Halo zones template function test
- * @details [long description]
- * 
- * @param rank [description]
- */
-void BorderTest(int rank)
-{
-
-    Dims ext(36,36);
-
-    const int bsize = 36*36;
-    const int halosize = 256;  
-    int * array = new int[bsize];
-    int * halo = new  int[halosize];
-    // int * test = new  int[halosize];
-
-    //fill with values
-
-    for(unsigned i = 0; i < bsize;i++){
-        array[i] = 0;
-    }
-    
-
-    for(unsigned i = 2; i < 4;i++)  {
-        for(unsigned j = 2; j < ext.x-2;j++){
-
-          if(i == 2){
-            if(j < ext.x / 2)
-              array[i * ext.x + j] = 1;
-            else
-              array[i * ext.x + j] = 2;
-          }else{
-
-            if(j < ext.x / 2)
-              array[i * ext.x + j] = 3;
-            else
-              array[i * ext.x + j] = 4;
-          }
-
-
-      }
-    }
-    // right
-    for(unsigned i = ext.x - 4;i < ext.x -2;i++){
-      for(unsigned j = 2; j < ext.y-2;j++){
-
-        if(i == ext.x - 4){
-          if(j < ext.y / 2)
-            array[j * ext.x + i] = 5;
-          else
-            array[j * ext.x + i] = 6;
-        }else{
-
-          if(j < ext.y / 2)
-            array[j * ext.x + i] = 7;
-          else
-            array[j * ext.x + i] = 8;
-        }
-      }
-    }
-
-    //bottom
-    for(unsigned i = ext.y - 4;i < ext.y - 2 ;i++){
-      for(unsigned j = 2; j < ext.x-2;j++){
-
-        if(i == ext.y - 4){
-          if(j < ext.x / 2)
-            array[i * ext.x + j] = 9;
-          else
-            array[i * ext.x + j] = 10;
-
-        }else{
-            if(j < ext.x / 2)
-            array[i * ext.x + j] = 11;
-          else
-            array[i * ext.x + j] = 12;
-        }
-      }
-    }
-
-    //left
-    for(unsigned i = 2 ;i < 4 ;i++){
-      for(unsigned j = 2; j < ext.y-2;j++){
-        if(i == 2){
-          if(j < ext.y / 2)
-            array[j * ext.x + i] = 13;
-          else
-            array[j * ext.x + i] = 14;
-
-        }else{
-
-          if(j < ext.y / 2)
-            array[j * ext.x + i] = 15;
-          else
-            array[j * ext.x + i] = 16;
-
-        }
-      }
-    }
-
-    PrintBlock(array, Dims(36,36), rank, true);
-
-    HaloToBuff(array, halo, Dims(36,36) );
-    
-    BuffToHalo(array, halo, Dims(36,36));
-
-    cout << "Validate: " << endl;
-    PrintBlock(array, Dims(36,36), rank, true);
-
-
-}
-
 /**
  * Main function of the project
  * @param [in] argc
@@ -1339,11 +1171,33 @@ int main(int argc, char *argv[])
 
 
 
-    // Initialize MPI
-    MPI_Init(&argc, &argv);
-
+    // thread support depends on parameters, parse them before MPI_Init
     ParseCommandline(argc, argv, parameters);
 
+    // Initialize MPI, helper progress thread calls MPI concurrently,
+    // compute threads do not call MPI at all
+    int required = MPI_THREAD_SINGLE;
+    int provided;
+
+    if(parameters.progress == PROGRESS_THREAD)
+        required = MPI_THREAD_MULTIPLE;
+    else if(parameters.threads > 1)
+        required = MPI_THREAD_FUNNELED;
+
+    MPI_Init_thread(&argc, &argv, required, &provided);
+
+#ifdef _OPENMP
+    omp_set_num_threads(parameters.threads);
+#else
+    parameters.threads = 1;
+#endif
+
+    // fall back to polling from computation
+    bool progressFallback = parameters.progress == PROGRESS_THREAD && provided < required;
+
+    if(progressFallback)
+        parameters.progress = PROGRESS_POLL;
+
     // intiialize zoltan library
     float version;
     Zoltan_Initialize(argc, argv, &version);
@@ -1352,6 +1206,11 @@ int main(int argc, char *argv[])
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
+    parameters.worldSize = size;
+
+    if(progressFallback && rank == 0)
+        printf("WARNING: MPI_THREAD_MULTIPLE not provided, polling progress used\n");
+
 
     TLogger::SetLevel(TLogger::BASIC);
 
@@ -1380,6 +1239,15 @@ int main(int argc, char *argv[])
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
+    // halo zone of a tile cannot be deeper than the domain edge
+    if (2 * parameters.temporalSteps > parameters.edgeSize)
+    {
+        if (rank == 0)
+            printf("ERROR: halo zone width 2*D exceeds domain edge N\n");
+
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
     if (parameters.IsRunSequntial())
     {
         if (rank == 0)
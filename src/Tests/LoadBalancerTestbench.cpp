@@ -0,0 +1,462 @@
+#include "../Sources/DLB/LoadBalancer.h"
+
+#include <iostream>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+using namespace std;
+using namespace DLB;
+
+const unsigned EDGE = 128;
+const Dims OBJ(8, 8);
+
+static bool ok = true;
+
+static void expect(bool cond, const string & what)
+{
+	if(!cond){
+		cout << "  failed: " << what << endl;
+		ok = false;
+	}
+}
+
+// sizes sum to objects, no part is empty
+static void expectSplit(const vector<unsigned> & sizes, unsigned parts, unsigned objects, const string & what)
+{
+	expect(sizes.size() == parts, what + " - number of parts");
+	expect(accumulate(sizes.begin(), sizes.end(), 0u) == objects, what + " - objects conserved");
+
+	for(auto s : sizes)
+		expect(s > 0, what + " - empty part");
+}
+
+// tiles are ordered by rank, not empty and cover every object exactly once
+static void expectLayout(const vector<TileDescriptor> & tiles, unsigned world, const string & what)
+{
+	unsigned n = EDGE / OBJ.x;
+	vector<int> owner(n * n, 0);
+
+	expect(tiles.size() == world, what + " - number of tiles");
+
+	for(unsigned k = 0; k < tiles.size(); k++){
+
+		Dims p = tiles[k].getPosition();
+		Dims s = tiles[k].getSize();
+
+		expect(tiles[k].getRank() == (int) k, what + " - tiles ordered by rank");
+		expect(s.x > 0 && s.y > 0, what + " - empty tile");
+		expect(p.x % OBJ.x == 0 && s.x % OBJ.x == 0 && p.y % OBJ.y == 0 && s.y % OBJ.y == 0,
+			   what + " - tile not aligned to objects");
+
+		for(unsigned y = p.y / OBJ.y; y < (p.y + s.y) / OBJ.y && y < n; y++)
+			for(unsigned x = p.x / OBJ.x; x < (p.x + s.x) / OBJ.x && x < n; x++)
+				owner[y * n + x]++;
+	}
+
+	for(auto o : owner)
+		expect(o == 1, what + " - object not covered exactly once");
+}
+
+
+static void testSplits(void)
+{
+	cout << "splitByPerform, splitByCost" << endl;
+
+	LoadBalancer lb(0, EDGE, 4, OBJ, 1.2);
+
+	// strong imbalance must not empty any part
+	expectSplit(lb.splitByPerform({1.0, 1000.0, 1.0, 1000.0}, 16), 4, 16, "splitByPerform strong");
+	expectSplit(lb.splitByPerform({1.0, 1.0, 1.0, 2.0}, 16), 4, 16, "splitByPerform mild");
+
+	vector<double> flat(16, 1.0);
+	vector<double> ramp;
+
+	for(unsigned i = 0; i < 16; i++)
+		ramp.push_back(1.0 + i);
+
+	vector<unsigned> even = lb.splitByCost({1.0, 1.0, 1.0, 1.0}, flat);
+	expectSplit(even, 4, 16, "splitByCost even");
+	expect(even == vector<unsigned>({4, 4, 4, 4}), "splitByCost even - equal parts");
+
+	expectSplit(lb.splitByCost({1000.0, 1.0, 1.0, 1.0}, flat), 4, 16, "splitByCost fast first");
+	expectSplit(lb.splitByCost({1.0, 1.0, 1.0, 1000.0}, ramp), 4, 16, "splitByCost fast last");
+	expectSplit(lb.splitByCost({0.0, 0.0, 0.0, 0.0}, flat), 4, 16, "splitByCost nothing measured");
+
+	// expensive objects at the end, the last part gets fewer of them
+	vector<unsigned> r = lb.splitByCost({1.0, 1.0, 1.0, 1.0}, ramp);
+	expectSplit(r, 4, 16, "splitByCost ramp");
+	expect(r.front() > r.back(), "splitByCost ramp - cheap objects in larger part");
+}
+
+
+static void testPartition(void)
+{
+	cout << "getPartition" << endl;
+
+	for(int strategy : {STRATEGY_WIDTHS, STRATEGY_2D}){
+		for(unsigned world : {4u, 8u, 16u}){
+
+			string what = "strategy " + to_string(strategy) + ", " + to_string(world) + " ranks";
+
+			LoadBalancer lb(0, EDGE, world, OBJ, 1.2, strategy);
+
+			vector<TileDescriptor> * tiles = lb.regularTiles();
+			expectLayout(*tiles, world, what + ", regular");
+
+			// every other rank slowed down, repeatedly repartitioned
+			for(int period = 0; period < 4; period++){
+
+				vector<double> times;
+
+				for(unsigned k = 0; k < world; k++){
+					Dims s = (*tiles)[k].getSize();
+					times.push_back(s.x * s.y * (k % 2 ? 20.0 : 1.0));
+				}
+
+				vector<TileDescriptor> * next = lb.getPartition(times, *tiles);
+
+				expectLayout(*next, world, what + ", period " + to_string(period));
+				expect(lb.isRowLayout(*next), what + " - not a row layout");
+
+				delete tiles;
+				tiles = next;
+			}
+
+			delete tiles;
+		}
+	}
+}
+
+
+static void testDiffusion(void)
+{
+	cout << "edgeShift, leftOf, rightOf, aboveOf, belowOf" << endl;
+
+	LoadBalancer lb(0, EDGE, 8, OBJ, 1.2, STRATEGY_DIFFUSION);
+
+	expect(lb.edgeShift(1.0, 4, 1.0, 4) == 0, "edgeShift balanced pair");
+	expect(lb.edgeShift(1.1, 4, 1.0, 4) == 0, "edgeShift within threshold");
+	expect(lb.edgeShift(2.0, 4, 1.0, 4) < 0, "edgeShift slow left - edge moves left");
+	expect(lb.edgeShift(1.0, 4, 2.0, 4) > 0, "edgeShift slow right - edge moves right");
+
+	// each edge of tile takes at most half of it
+	expect(lb.edgeShift(1000.0, 5, 1.0, 5) >= -2, "edgeShift left bound");
+	expect(lb.edgeShift(1.0, 5, 1000.0, 5) <= 2, "edgeShift right bound");
+	expect(lb.edgeShift(1000.0, 1, 1.0, 1) == 0, "edgeShift single object");
+
+	// row neighbors match geometry of regular mesh
+	vector<TileDescriptor> * tiles = lb.regularTiles();
+
+	for(auto & t : *tiles){
+
+		int l = lb.leftOf(t.getRank());
+		int r = lb.rightOf(t.getRank());
+
+		if(l == MPI_PROC_NULL)
+			expect(t.getPosition().x == 0, "leftOf - missing neighbor");
+		else
+			expect((*tiles)[l].getPosition().x + (*tiles)[l].getSize().x == t.getPosition().x &&
+				   (*tiles)[l].getPosition().y == t.getPosition().y, "leftOf - wrong neighbor");
+
+		if(r == MPI_PROC_NULL)
+			expect(t.getPosition().x + t.getSize().x == EDGE, "rightOf - missing neighbor");
+		else
+			expect(lb.leftOf(r) == t.getRank(), "rightOf - not inverse of leftOf");
+
+		int a = lb.aboveOf(t.getRank());
+		int b = lb.belowOf(t.getRank());
+
+		if(a == MPI_PROC_NULL)
+			expect(t.getPosition().y == 0, "aboveOf - missing neighbor");
+		else
+			expect((*tiles)[a].getPosition().y + (*tiles)[a].getSize().y == t.getPosition().y &&
+				   (*tiles)[a].getPosition().x == t.getPosition().x &&
+				   lb.rowOf(a) + 1 == lb.rowOf(t.getRank()), "aboveOf - wrong neighbor");
+
+		if(b == MPI_PROC_NULL)
+			expect(t.getPosition().y + t.getSize().y == EDGE, "belowOf - missing neighbor");
+		else
+			expect(lb.aboveOf(b) == t.getRank(), "belowOf - not inverse of aboveOf");
+	}
+
+	delete tiles;
+
+	// shifts of diffuse() applied to a row, every tile owns its right edge
+	vector<unsigned> widths(4, 4);
+	vector<double> speed = {1.0, 5.0, 1.0, 9.0};
+	bool moved = false;
+
+	for(int period = 0; period < 50; period++){
+
+		vector<int> shift(widths.size(), 0);
+
+		for(unsigned k = 0; k + 1 < widths.size(); k++)
+			shift[k] = lb.edgeShift(widths[k] * speed[k], widths[k], widths[k + 1] * speed[k + 1], widths[k + 1]);
+
+		for(unsigned k = 0; k + 1 < widths.size(); k++){
+			widths[k] += shift[k];
+			widths[k + 1] -= shift[k];
+			moved = moved || shift[k] != 0;
+		}
+
+		expectSplit(widths, 4, 16, "diffusion period " + to_string(period));
+	}
+
+	expect(moved, "diffusion - no edge moved");
+	expect(widths[0] > widths[1] && widths[2] > widths[3], "diffusion - slow tiles did not shrink");
+
+	// row bands, slow second row gives its height away
+	vector<unsigned> heights(4, 4);
+	vector<double> rowSpeed = {1.0, 8.0, 1.0, 1.0};
+
+	for(int period = 0; period < 50; period++){
+
+		vector<int> shift(heights.size(), 0);
+
+		for(unsigned k = 0; k + 1 < heights.size(); k++)
+			shift[k] = lb.edgeShift(heights[k] * rowSpeed[k], heights[k], heights[k + 1] * rowSpeed[k + 1], heights[k + 1]);
+
+		for(unsigned k = 0; k + 1 < heights.size(); k++){
+			heights[k] += shift[k];
+			heights[k + 1] -= shift[k];
+		}
+
+		expectSplit(heights, 4, 16, "row diffusion period " + to_string(period));
+	}
+
+	expect(heights[1] < 4, "row diffusion - slow row did not shrink");
+}
+
+
+static void testIncremental(void)
+{
+	cout << "movedObjects, interpolate, budgetStep, predictMax" << endl;
+
+	const unsigned world = 8;
+	const unsigned budget = 32;
+
+	LoadBalancer lb(0, EDGE, world, OBJ, 1.2);
+
+	vector<TileDescriptor> * from = lb.regularTiles();
+	vector<double> times;
+
+	for(unsigned k = 0; k < world; k++){
+		Dims s = (*from)[k].getSize();
+		times.push_back(s.x * s.y * (k % 2 ? 20.0 : 1.0));
+	}
+
+	vector<TileDescriptor> * to = lb.getPartition(times, *from);
+
+	expect(lb.movedObjects(*from, *from) == 0, "movedObjects same layout");
+	expect(lb.movedObjects(*from, *to) > budget, "movedObjects - partition too close for budget");
+
+	vector<TileDescriptor> * a = lb.interpolate(*from, *to, 0.0);
+	vector<TileDescriptor> * b = lb.interpolate(*from, *to, 1.0);
+	vector<TileDescriptor> * half = lb.interpolate(*from, *to, 0.5);
+
+	expect(lb.movedObjects(*a, *from) == 0, "interpolate 0 - not from");
+	expect(lb.movedObjects(*b, *to) == 0, "interpolate 1 - not to");
+	expectLayout(*half, world, "interpolate 0.5");
+	expect(lb.isRowLayout(*half), "interpolate 0.5 - not a row layout");
+
+	delete a;
+	delete b;
+	delete half;
+
+	// every step within budget, from reaches to
+	vector<TileDescriptor> * prev = new vector<TileDescriptor>(*from);
+	bool last = false;
+	int steps = 0;
+
+	while(!last && steps < 100){
+
+		vector<TileDescriptor> * step = lb.budgetStep(*prev, *to, budget, last);
+		string what = "budgetStep " + to_string(steps);
+
+		unsigned moved = lb.movedObjects(*prev, *step);
+
+		expectLayout(*step, world, what);
+		expect(moved > 0, what + " - no progress");
+
+		// over budget only if no smaller step exists
+		if(moved > budget)
+			for(double f = 0.01; f < 1.0; f += 0.01){
+				vector<TileDescriptor> * tls = lb.interpolate(*prev, *to, f);
+				unsigned m = lb.movedObjects(*prev, *tls);
+				expect(m == 0 || m >= moved, what + " - budget exceeded");
+				delete tls;
+			}
+
+		delete prev;
+		prev = step;
+		steps++;
+	}
+
+	expect(last, "budgetStep - to not reached");
+	expect(steps > 1, "budgetStep - budget ignored");
+	expect(lb.movedObjects(*prev, *to) == 0, "budgetStep - last step is not to");
+
+	delete prev;
+
+	// unchanged layout keeps measured times, partition lowers the slowest rank
+	double slowest = *max_element(times.begin(), times.end());
+
+	expect(lb.predictMax(times, *from, *from, {}) == slowest, "predictMax same layout");
+	expect(lb.predictMax(times, *from, *to, {}) < slowest, "predictMax - partition not faster");
+
+	delete from;
+	delete to;
+}
+
+
+static void testNodes(void)
+{
+	cout << "splitByNode, nodesBalanced" << endl;
+
+	LoadBalancer lb(0, EDGE, 4, OBJ, 1.2);
+
+	vector<int> node = {0, 0, 1, 1};
+	vector<unsigned> current(4, 4);
+	vector<double> flat(16, 1.0);
+
+	// balanced nodes keep their segments, objects move within node
+	vector<unsigned> kept = lb.splitByNode({1.0, 3.0, 1.0, 1.0}, node, current, flat, true);
+	expectSplit(kept, 4, 16, "splitByNode keep");
+	expect(kept[0] + kept[1] == 8 && kept[2] + kept[3] == 8, "splitByNode keep - segment changed");
+	expect(kept[1] > kept[0], "splitByNode keep - faster part not larger");
+
+	// faster node takes objects of the other one
+	vector<unsigned> moved = lb.splitByNode({2.0, 2.0, 1.0, 1.0}, node, current, flat, false);
+	expectSplit(moved, 4, 16, "splitByNode move");
+	expect(moved[0] + moved[1] > moved[2] + moved[3], "splitByNode move - faster node not larger");
+
+	expectSplit(lb.splitByNode({1000.0, 1000.0, 1.0, 1.0}, node, current, flat, false), 4, 16, "splitByNode strong");
+	expectSplit(lb.splitByNode({1.0, 1.0, 1.0, 1000.0}, node, current, flat, false), 4, 16, "splitByNode strong last");
+
+	expect(lb.nodesBalanced({1.0, 1.0, 1.0, 1.0}, {1.0, 1.0, 1.0, 1.0}, node), "nodesBalanced equal nodes");
+	expect(lb.nodesBalanced({1.0, 3.0, 2.0, 2.0}, {1.0, 3.0, 2.0, 2.0}, node), "nodesBalanced imbalance within node");
+	expect(!lb.nodesBalanced({1.0, 1.0, 1.0, 1.0}, {2.0, 2.0, 1.0, 1.0}, node), "nodesBalanced doubled node");
+
+	// node-aware partition, ranks of node consecutive
+	const unsigned world = 8;
+	LoadBalancer na(0, EDGE, world, OBJ, 1.2, STRATEGY_2D, 1, true);
+	vector<int> hosts;
+
+	for(unsigned k = 0; k < world; k++)
+		hosts.push_back(k / 4);
+
+	na.setHosts(hosts);
+
+	vector<TileDescriptor> * tiles = na.regularTiles();
+
+	for(int period = 0; period < 4; period++){
+
+		vector<double> times;
+
+		for(unsigned k = 0; k < world; k++){
+			Dims s = (*tiles)[k].getSize();
+			times.push_back(s.x * s.y * (hosts[k] ? 4.0 : 1.0));
+		}
+
+		vector<TileDescriptor> * next = na.getPartition(times, *tiles);
+
+		expectLayout(*next, world, "node-aware period " + to_string(period));
+		expect(na.isRowLayout(*next), "node-aware - not a row layout");
+
+		delete tiles;
+		tiles = next;
+	}
+
+	unsigned fastArea = 0;
+
+	for(unsigned k = 0; k < world; k++)
+		if(!hosts[k])
+			fastArea += (*tiles)[k].getSize().x * (*tiles)[k].getSize().y;
+
+	expect(fastArea > EDGE * EDGE / 2, "node-aware - faster node not larger");
+
+	delete tiles;
+}
+
+
+static void testPlacement(void)
+{
+	cout << "setHosts, rankAt" << endl;
+
+	const unsigned world = 16;
+	LoadBalancer lb(0, EDGE, world, OBJ, 1.2);
+	vector<int> hosts;
+
+	// ranks of nodes interleaved, 4 ranks per node
+	for(unsigned k = 0; k < world; k++)
+		hosts.push_back(k % 4);
+
+	lb.setHosts(hosts);
+
+	vector<TileDescriptor> * tiles = lb.regularTiles();
+	expectLayout(*tiles, world, "placement");
+
+	// slots are permutation of ranks
+	vector<int> seen(world, 0);
+
+	for(unsigned s = 0; s < world; s++)
+		if(lb.rankAt(s) >= 0 && lb.rankAt(s) < (int) world)
+			seen[lb.rankAt(s)]++;
+
+	expect(std::count(seen.begin(), seen.end(), 1) == (int) world, "placement - slots not permutation of ranks");
+
+	// tiles of node form compact block, 2 x 2 slots
+	for(int h = 0; h < 4; h++){
+
+		unsigned x0 = EDGE, y0 = EDGE, x1 = 0, y1 = 0, area = 0;
+
+		for(auto & t : *tiles){
+
+			if(hosts[t.getRank()] != h)
+				continue;
+
+			Dims p = t.getPosition();
+			Dims s = t.getSize();
+
+			x0 = std::min(x0, p.x);
+			y0 = std::min(y0, p.y);
+			x1 = std::max(x1, p.x + s.x);
+			y1 = std::max(y1, p.y + s.y);
+			area += s.x * s.y;
+		}
+
+		expect(area == EDGE * EDGE / 4, "placement - node area");
+		expect((x1 - x0) * (y1 - y0) == area, "placement - node " + to_string(h) + " not rectangle");
+		expect(x1 - x0 == y1 - y0, "placement - node " + to_string(h) + " not square block");
+	}
+
+	delete tiles;
+
+	// nodes differ in size, row-major order kept
+	LoadBalancer uneven(0, EDGE, 8, OBJ, 1.2);
+	uneven.setHosts({0, 0, 0, 1, 1, 1, 1, 1});
+
+	tiles = uneven.regularTiles();
+	expectLayout(*tiles, 8, "uneven placement");
+
+	for(unsigned s = 0; s < 8; s++)
+		expect(uneven.rankAt(s) == (int) s, "uneven placement - not row-major");
+
+	delete tiles;
+}
+
+
+int main()
+{
+	testSplits();
+	testPartition();
+	testDiffusion();
+	testIncremental();
+	testNodes();
+	testPlacement();
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+
+	return ok ? 0 : 1;
+}
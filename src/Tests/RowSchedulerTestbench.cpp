@@ -0,0 +1,51 @@
+#include "../Sources/DLB/RowScheduler.h"
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+using DLB::RowScheduler;
+
+int main()
+{
+	const int TOP = 3;
+	const int BOTTOM = 1001;
+
+	bool ok = true;
+
+	for(unsigned chunk : {1u, 4u, 7u, 64u, 2000u}){
+
+		RowScheduler sched(chunk);
+		vector<atomic<int>> hits(BOTTOM);
+
+		for(auto & h : hits)
+			h = 0;
+
+		// uneven rows, slow threads get robbed
+		sched.run(TOP, BOTTOM, [&](int begin, int end){
+
+			for(int i = begin; i < end; i++){
+				hits[i]++;
+
+				if(i % 97 == 0)
+					this_thread::sleep_for(chrono::microseconds(200));
+			}
+		});
+
+		for(int i = 0; i < BOTTOM; i++){
+			if(hits[i] != (i >= TOP ? 1 : 0)){
+				cout << "chunk " << chunk << ": row " << i << " computed " << hits[i] << " times" << endl;
+				ok = false;
+			}
+		}
+
+		cout << "chunk " << chunk << " steals: " << sched.getSteals() << endl;
+	}
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#include "../Sources/StencilKernels.h"
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+// row length deliberately not a multiple of any vector width
+const size_t EDGE = 77;
+
+int main()
+{
+	const size_t size = EDGE * EDGE;
+
+	float * oldTemp = new float[size];
+	float * params  = new float[size];
+	int   * map     = new int[size];
+	float * scalar  = new float[size];
+	float * simd    = new float[size];
+	float * wres    = new float[size];
+	float * weights = new float[STENCIL_PLANES * size];
+
+	default_random_engine generator(42);
+	uniform_real_distribution<float> temp(20.0f, 100.0f);
+	uniform_real_distribution<float> param(0.1f, 1.0f);
+	uniform_int_distribution<int> air(0, 2);
+
+	for(size_t i = 0; i < size; i++){
+		oldTemp[i] = temp(generator);
+		params[i] = param(generator);
+		map[i] = air(generator);
+		scalar[i] = simd[i] = wres[i] = 0.0f;
+	}
+
+	BuildStencilWeights(params, map, weights, EDGE, EDGE, 0.05f, 20.0f);
+
+	for(size_t i = 2; i < EDGE - 2; i++){
+		ComputeRowScalar(oldTemp, scalar, params, map, i, 2, EDGE - 2, EDGE, 0.05f, 20.0f);
+		ComputeRowSimd(oldTemp, simd, params, map, i, 2, EDGE - 2, EDGE, 0.05f, 20.0f);
+		ComputeRowWeights(oldTemp, wres, weights, i, 2, EDGE - 2, EDGE);
+	}
+
+	float maxDiff = 0.0f;
+
+	for(size_t i = 0; i < size; i++){
+		maxDiff = max(maxDiff, fabs(scalar[i] - simd[i]));
+		maxDiff = max(maxDiff, fabs(scalar[i] - wres[i]));
+	}
+
+	cout << "extension: " << SimdExtension() << endl;
+	cout << "max difference: " << maxDiff << endl;
+	cout << (maxDiff < 1e-4f ? "OK" : "FAILED") << endl;
+
+	delete[] oldTemp;
+	delete[] params;
+	delete[] map;
+	delete[] scalar;
+	delete[] simd;
+	delete[] wres;
+	delete[] weights;
+
+	return maxDiff < 1e-4f ? 0 : 1;
+}